@@ -0,0 +1,89 @@
+#ifndef MINUNIT_H
+#define MINUNIT_H
+
+/* The subset of the minunit (https://github.com/siu/minunit) test
+ * macros used by the unit tests, so they build without fetching it.
+ * The upstream header can be used in its place, both report with a
+ * last line of "N tests, N assertions, N failures" */
+
+#include <stdio.h>
+
+static int minunit_run = 0;
+static int minunit_assert = 0;
+static int minunit_fail = 0;
+static int minunit_status = 0; // Set once the current test fails
+
+static void (*minunit_setup)(void) = NULL;
+static void (*minunit_teardown)(void) = NULL;
+
+#define MU_TEST(method_name) static void method_name(void)
+#define MU_TEST_SUITE(suite_name) static void suite_name(void)
+
+#define MU_SUITE_CONFIGURE(setup_fun, teardown_fun) do {\
+    minunit_setup = setup_fun;\
+    minunit_teardown = teardown_fun;\
+} while (0)
+
+#define MU_RUN_SUITE(suite_name) do {\
+    suite_name();\
+    minunit_setup = NULL;\
+    minunit_teardown = NULL;\
+} while (0)
+
+#define MU_RUN_TEST(test) do {\
+    if (minunit_setup) (*minunit_setup)();\
+    minunit_status = 0;\
+    test();\
+    minunit_run++;\
+    if (minunit_status) {\
+        minunit_fail++;\
+        printf("F");\
+    }\
+    fflush(stdout);\
+    if (minunit_teardown) (*minunit_teardown)();\
+} while (0)
+
+#define MU_REPORT() printf("\n\n%d tests, %d assertions, %d failures\n", minunit_run, minunit_assert, minunit_fail)
+
+#define MU_EXIT_CODE (minunit_fail != 0)
+
+#define mu_check(test) do {\
+    minunit_assert++;\
+    if (!(test)) {\
+        printf("\n%s failed:\n\t%s:%d: %s\n", __func__, __FILE__, __LINE__, #test);\
+        minunit_status = 1;\
+        return;\
+    } else {\
+        printf(".");\
+    }\
+} while (0)
+
+#define mu_assert_int_eq(expected, result) do {\
+    long long minunit_expected = (expected);\
+    long long minunit_result = (result);\
+    minunit_assert++;\
+    if (minunit_expected != minunit_result) {\
+        printf("\n%s failed:\n\t%s:%d: %lld expected but was %lld\n", __func__, __FILE__, __LINE__,\
+               minunit_expected, minunit_result);\
+        minunit_status = 1;\
+        return;\
+    } else {\
+        printf(".");\
+    }\
+} while (0)
+
+#define mu_assert_uint_eq(expected, result) do {\
+    unsigned long long minunit_expected = (expected);\
+    unsigned long long minunit_result = (result);\
+    minunit_assert++;\
+    if (minunit_expected != minunit_result) {\
+        printf("\n%s failed:\n\t%s:%d: %llu expected but was %llu\n", __func__, __FILE__, __LINE__,\
+               minunit_expected, minunit_result);\
+        minunit_status = 1;\
+        return;\
+    } else {\
+        printf(".");\
+    }\
+} while (0)
+
+#endif /* MINUNIT_H */
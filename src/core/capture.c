@@ -0,0 +1,419 @@
+#include "capture.h"
+
+#include <string.h>
+
+// Runs of unchanged pixels followed by runs of changed pixels, as XORs
+unsigned long encode_delta_rle(uint32_t const *pixels, uint32_t const *previous, uint8_t *dest) {
+
+    uint8_t *out = dest;
+    int count = CAPTURE_WIDTH * CAPTURE_HEIGHT;
+    int i = 0;
+
+    while (i < count) {
+        int unchanged = 0;
+        while (i < count && unchanged < DELTA_RLE_MAX_RUN && pixels[i] == previous[i]) {
+            unchanged++;
+            i++;
+        }
+
+        int changed = 0;
+        while (i + changed < count && changed < DELTA_RLE_MAX_RUN && pixels[i + changed] != previous[i + changed]) {
+            changed++;
+        }
+
+        *out++ = unchanged & 0xFF;
+        *out++ = unchanged >> 8;
+        *out++ = changed & 0xFF;
+        *out++ = changed >> 8;
+        for (int j = 0; j < changed; j++, i++) {
+            uint32_t x = pixels[i] ^ previous[i];
+            *out++ = x & 0xFF;
+            *out++ = (x >> 8) & 0xFF;
+            *out++ = (x >> 16) & 0xFF;
+            *out++ = x >> 24;
+        }
+    }
+
+    return out - dest;
+}
+
+
+#ifdef VIDEO_CAPTURE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../non_core/logger.h"
+
+/* Frames and audio are passed to the writer thread through single
+ * producer single consumer rings, the emulator thread owns the heads
+ * and the writer thread owns the tails */
+#define FRAME_RING_SIZE 32 // Must be a power of 2
+#define AUDIO_RING_SIZE 0x10000 // Stereo samples, must be a power of 2
+#define FRAME_PIXELS (CAPTURE_WIDTH * CAPTURE_HEIGHT)
+
+typedef struct {
+    uint32_t pixels[FRAME_PIXELS];
+    uint32_t frame_no;
+} Captured_Frame;
+
+static Captured_Frame frame_ring[FRAME_RING_SIZE];
+static uint64_t frame_head = 0;
+static uint64_t frame_tail = 0;
+
+static int16_t audio_ring[AUDIO_RING_SIZE * 2];
+static uint64_t audio_head = 0;
+static uint64_t audio_tail = 0;
+static uint64_t audio_dropped = 0; // Samples which didn't fit, written as silence
+
+static unsigned long frames_captured = 0;
+static unsigned long frames_dropped = 0;
+static uint32_t newest_frame_no; // Including frames which were dropped
+
+// Only used by the writer thread
+static FILE *video_file = NULL;
+static FILE *audio_file = NULL;
+static Capture_Format video_format;
+static unsigned audio_rate;
+static uint32_t previous[FRAME_PIXELS];
+static int have_previous = 0;
+static uint32_t last_frame_no;
+static uint64_t frames_written = 0;
+static uint64_t samples_written = 0;
+static uint64_t audio_dropped_written = 0;
+static uint8_t encoded[DELTA_RLE_MAX_SIZE];
+static uint8_t converted[FRAME_PIXELS * 3];
+
+static int running = 0;
+static int stopping = 0;
+static int writer_sleeping = 0;
+static pthread_t writer;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wake = PTHREAD_COND_INITIALIZER;
+
+
+static void write_u16(FILE *f, uint16_t v) {
+    uint8_t b[2] = {v & 0xFF, v >> 8};
+    fwrite(b, 1, 2, f);
+}
+
+static void write_u32(FILE *f, uint32_t v) {
+    uint8_t b[4] = {v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, v >> 24};
+    fwrite(b, 1, 4, f);
+}
+
+static void write_wav_header(FILE *f, uint32_t samples) {
+    uint32_t data_size = samples * 4;
+    fwrite("RIFF", 1, 4, f);
+    write_u32(f, 36 + data_size);
+    fwrite("WAVEfmt ", 1, 8, f);
+    write_u32(f, 16);
+    write_u16(f, 1); // PCM
+    write_u16(f, 2); // Stereo
+    write_u32(f, audio_rate);
+    write_u32(f, audio_rate * 4);
+    write_u16(f, 4);
+    write_u16(f, 16);
+    fwrite("data", 1, 4, f);
+    write_u32(f, data_size);
+}
+
+static void write_video_header() {
+    switch (video_format) {
+        case CAPTURE_Y4M:
+            fprintf(video_file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C444\n",
+                CAPTURE_WIDTH, CAPTURE_HEIGHT, CAPTURE_FPS_NUM, CAPTURE_FPS_DEN);
+            break;
+        case CAPTURE_DELTA_RLE:
+            fwrite(DELTA_RLE_MAGIC, 1, 4, video_file);
+            write_u16(video_file, CAPTURE_WIDTH);
+            write_u16(video_file, CAPTURE_HEIGHT);
+            write_u32(video_file, CAPTURE_FPS_NUM);
+            write_u32(video_file, CAPTURE_FPS_DEN);
+            break;
+        default: break;
+    }
+}
+
+// Write a frame, the frame before is in previous if there was one
+static void write_video_frame(uint32_t const *pixels) {
+
+    switch (video_format) {
+        case CAPTURE_RAW:
+            for (int i = 0; i < FRAME_PIXELS; i++) {
+                converted[(i * 3)] = (pixels[i] >> 16) & 0xFF;
+                converted[(i * 3) + 1] = (pixels[i] >> 8) & 0xFF;
+                converted[(i * 3) + 2] = pixels[i] & 0xFF;
+            }
+            fwrite(converted, 1, sizeof(converted), video_file);
+            break;
+
+        case CAPTURE_Y4M: {
+            // BT.601 limited range, Y then U then V planes
+            uint8_t *y_plane = converted;
+            uint8_t *u_plane = converted + FRAME_PIXELS;
+            uint8_t *v_plane = converted + (FRAME_PIXELS * 2);
+            for (int i = 0; i < FRAME_PIXELS; i++) {
+                int r = (pixels[i] >> 16) & 0xFF;
+                int g = (pixels[i] >> 8) & 0xFF;
+                int b = pixels[i] & 0xFF;
+                y_plane[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+                u_plane[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+                v_plane[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+            }
+            fwrite("FRAME\n", 1, 6, video_file);
+            fwrite(converted, 1, sizeof(converted), video_file);
+            break;
+        }
+
+        case CAPTURE_DELTA_RLE: {
+            if (!have_previous) {
+                memset(previous, 0, sizeof(previous));
+            }
+            unsigned long size = encode_delta_rle(pixels, previous, encoded);
+            write_u32(video_file, size);
+            fwrite(encoded, 1, size, video_file);
+            break;
+        }
+    }
+
+    if (pixels != previous) {
+        memcpy(previous, pixels, sizeof(previous));
+    }
+    have_previous = 1;
+    frames_written++;
+}
+
+static void write_silence(uint64_t samples) {
+    static const int16_t silence[256 * 2];
+    while (samples > 0) {
+        unsigned n = samples > 256 ? 256 : samples;
+        fwrite(silence, sizeof(int16_t) * 2, n, audio_file);
+        samples -= n;
+        samples_written += n;
+    }
+}
+
+// Write every queued sample
+static void write_audio() {
+
+    uint64_t head = __atomic_load_n(&audio_head, __ATOMIC_ACQUIRE);
+    while (audio_tail != head) {
+        uint64_t start = audio_tail & (AUDIO_RING_SIZE - 1);
+        uint64_t n = head - audio_tail;
+        if (start + n > AUDIO_RING_SIZE) {
+            n = AUDIO_RING_SIZE - start;
+        }
+        if (audio_file != NULL) {
+            fwrite(&audio_ring[start * 2], sizeof(int16_t) * 2, n, audio_file);
+            samples_written += n;
+        }
+        __atomic_store_n(&audio_tail, audio_tail + n, __ATOMIC_RELEASE);
+    }
+
+    // Samples which didn't fit are replaced with silence to keep the timing
+    uint64_t dropped = __atomic_load_n(&audio_dropped, __ATOMIC_ACQUIRE);
+    if (audio_file != NULL && dropped != audio_dropped_written) {
+        write_silence(dropped - audio_dropped_written);
+    }
+    audio_dropped_written = dropped;
+}
+
+// Write every queued frame, repeating frames to fill any gaps
+static void write_frames() {
+
+    uint64_t head = __atomic_load_n(&frame_head, __ATOMIC_ACQUIRE);
+    while (frame_tail != head) {
+        Captured_Frame *cf = &frame_ring[frame_tail & (FRAME_RING_SIZE - 1)];
+
+        if (have_previous) {
+            for (uint32_t n = last_frame_no + 1; n < cf->frame_no; n++) {
+                write_video_frame(previous);
+            }
+        }
+        write_video_frame(cf->pixels);
+        last_frame_no = cf->frame_no;
+
+        __atomic_store_n(&frame_tail, frame_tail + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void *capture_writer(void *arg) {
+    (void)arg;
+
+    for (;;) {
+        write_audio();
+        write_frames();
+
+        pthread_mutex_lock(&writer_mutex);
+        __atomic_store_n(&writer_sleeping, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&frame_head, __ATOMIC_SEQ_CST) == frame_tail &&
+               __atomic_load_n(&audio_head, __ATOMIC_SEQ_CST) == audio_tail &&
+               !__atomic_load_n(&stopping, __ATOMIC_SEQ_CST)) {
+            pthread_cond_wait(&writer_wake, &writer_mutex);
+        }
+        __atomic_store_n(&writer_sleeping, 0, __ATOMIC_SEQ_CST);
+        int stop = __atomic_load_n(&stopping, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&writer_mutex);
+
+        if (stop) {
+            write_audio();
+            write_frames();
+            return NULL;
+        }
+    }
+}
+
+// Only ever waits for the writer thread to be put to sleep or woken
+static void wake_writer() {
+    if (__atomic_load_n(&writer_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&writer_mutex);
+        pthread_cond_signal(&writer_wake);
+        pthread_mutex_unlock(&writer_mutex);
+    }
+}
+
+
+void capture_frame(uint32_t const *pixels, uint32_t frame_no) {
+
+    if (!running) {
+        return;
+    }
+
+    newest_frame_no = frame_no;
+    uint64_t head = frame_head;
+    if (head - __atomic_load_n(&frame_tail, __ATOMIC_ACQUIRE) >= FRAME_RING_SIZE) {
+        frames_dropped++;
+        return;
+    }
+
+    Captured_Frame *cf = &frame_ring[head & (FRAME_RING_SIZE - 1)];
+    memcpy(cf->pixels, pixels, sizeof(cf->pixels));
+    cf->frame_no = frame_no;
+    __atomic_store_n(&frame_head, head + 1, __ATOMIC_SEQ_CST);
+    frames_captured++;
+    wake_writer();
+}
+
+void capture_audio(int16_t const *samples, unsigned count) {
+
+    if (!running) {
+        return;
+    }
+
+    uint64_t head = audio_head;
+    uint64_t space = AUDIO_RING_SIZE - (head - __atomic_load_n(&audio_tail, __ATOMIC_ACQUIRE));
+    if (count > space) {
+        __atomic_store_n(&audio_dropped, audio_dropped + (count - space), __ATOMIC_RELEASE);
+        count = space;
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        uint64_t pos = (head + i) & (AUDIO_RING_SIZE - 1);
+        audio_ring[pos * 2] = samples[i * 2];
+        audio_ring[(pos * 2) + 1] = samples[(i * 2) + 1];
+    }
+    __atomic_store_n(&audio_head, head + count, __ATOMIC_SEQ_CST);
+}
+
+void get_capture_stats(unsigned long *captured, unsigned long *dropped) {
+    *captured = frames_captured;
+    *dropped = frames_dropped;
+}
+
+
+int start_capture(char const *video_path, Capture_Format format, char const *audio_path, unsigned sample_rate) {
+
+    if (running) {
+        return 0;
+    }
+
+    video_file = fopen(video_path, "wb");
+    if (video_file == NULL) {
+        log_message(LOG_ERROR, "Unable to open capture file %s\n", video_path);
+        return 0;
+    }
+
+    audio_file = NULL;
+    audio_rate = sample_rate;
+    if (audio_path != NULL) {
+        audio_file = fopen(audio_path, "wb");
+        if (audio_file == NULL) {
+            log_message(LOG_ERROR, "Unable to open capture file %s\n", audio_path);
+            fclose(video_file);
+            return 0;
+        }
+        // Sizes are filled in once capture stops
+        write_wav_header(audio_file, 0);
+    }
+
+    video_format = format;
+    write_video_header();
+
+    frame_head = frame_tail = 0;
+    audio_head = audio_tail = 0;
+    audio_dropped = audio_dropped_written = 0;
+    frames_captured = frames_dropped = 0;
+    frames_written = samples_written = 0;
+    have_previous = 0;
+    stopping = 0;
+    writer_sleeping = 0;
+
+    if (pthread_create(&writer, NULL, capture_writer, NULL) != 0) {
+        log_message(LOG_ERROR, "Failed to start capture thread\n");
+        fclose(video_file);
+        if (audio_file != NULL) {
+            fclose(audio_file);
+        }
+        return 0;
+    }
+
+    running = 1;
+    log_message(LOG_INFO, "Capturing video to %s\n", video_path);
+    return 1;
+}
+
+void stop_capture() {
+
+    if (!running) {
+        return;
+    }
+
+    pthread_mutex_lock(&writer_mutex);
+    __atomic_store_n(&stopping, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_signal(&writer_wake);
+    pthread_mutex_unlock(&writer_mutex);
+    pthread_join(writer, NULL);
+    running = 0;
+
+    // Frames dropped at the end are filled in too
+    if (have_previous) {
+        for (uint32_t n = last_frame_no + 1; n <= newest_frame_no; n++) {
+            write_video_frame(previous);
+        }
+    }
+
+    fclose(video_file);
+    video_file = NULL;
+
+    if (audio_file != NULL) {
+        // Pad the audio to the length of the video
+        uint64_t video_samples = (frames_written * audio_rate * CAPTURE_FPS_DEN) / CAPTURE_FPS_NUM;
+        if (samples_written < video_samples) {
+            write_silence(video_samples - samples_written);
+        }
+        fseek(audio_file, 0, SEEK_SET);
+        write_wav_header(audio_file, samples_written);
+        fclose(audio_file);
+        audio_file = NULL;
+    }
+
+    log_message(LOG_INFO, "Captured %d frames, %d dropped\n", (int)frames_captured, (int)frames_dropped);
+}
+
+int capture_running() {
+    return running;
+}
+
+#endif /* VIDEO_CAPTURE */
@@ -0,0 +1,67 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+/* Video frames and audio samples are copied into bounded rings by the
+ * emulator thread and written to files on a background thread. The
+ * emulator thread never waits, frames which don't fit in the ring are
+ * dropped and counted. Frames missing from the video (dropped or not
+ * rendered) are filled in by repeating the previous frame, so the video
+ * stays at the Gameboy's framerate and in step with the audio.
+ *
+ * CAPTURE_RAW: 160x144 24 bit RGB frames one after another
+ * CAPTURE_Y4M: YUV4MPEG2 4:4:4 video
+ * CAPTURE_DELTA_RLE: Lossless, each frame is XORed with the previous
+ *                    frame and runs of unchanged pixels skipped */
+typedef enum {
+    CAPTURE_RAW = 0,
+    CAPTURE_Y4M = 1,
+    CAPTURE_DELTA_RLE = 2
+} Capture_Format;
+
+#define CAPTURE_WIDTH 160
+#define CAPTURE_HEIGHT 144
+#define CAPTURE_FPS_NUM 4194304 // Gameboy clock speed
+#define CAPTURE_FPS_DEN 70224 // Cycles per frame
+
+/* Delta RLE format, all values little endian:
+ * header: "GBDR", uint16 width, uint16 height, uint32 fps numerator,
+ *         uint32 fps denominator
+ * frame:  uint32 number of bytes following, then until the end of the
+ *         frame: uint16 unchanged pixels, uint16 changed pixels followed
+ *         by that many uint32 XORs with the previous frame's pixels.
+ *         The frame before the first is all 0 */
+#define DELTA_RLE_MAGIC "GBDR"
+#define DELTA_RLE_MAX_RUN 0xFFFF
+
+/* Start capturing video in the given format to video_path, and stereo
+ * 16 bit audio at sample_rate to a WAV file at audio_path if not NULL.
+ * returns 1 if successful, 0 otherwise */
+int start_capture(char const *video_path, Capture_Format format, char const *audio_path, unsigned sample_rate);
+
+// Write everything captured so far and close the files
+void stop_capture();
+
+int capture_running();
+
+/* Queue a 160x144 frame of 0xXXRRGGBB pixels, frame_no is the
+ * number of the frame since the emulator started */
+void capture_frame(uint32_t const *pixels, uint32_t frame_no);
+
+/* Queue count stereo samples (left then right), to be called by
+ * the platform's sound output as samples are produced. No platform
+ * calls it yet, so the WAV file is written without any samples */
+void capture_audio(int16_t const *samples, unsigned count);
+
+/* Obtain the number of frames queued and the number which
+ * were dropped because the ring was full */
+void get_capture_stats(unsigned long *captured, unsigned long *dropped);
+
+/* Encode a frame as its differences from the previous frame in the
+ * delta RLE format, without the leading size. dest must have room for
+ * DELTA_RLE_MAX_SIZE bytes. returns the number of bytes written */
+#define DELTA_RLE_MAX_SIZE (CAPTURE_WIDTH * CAPTURE_HEIGHT * 6)
+unsigned long encode_delta_rle(uint32_t const *pixels, uint32_t const *previous, uint8_t *dest);
+
+#endif /* CAPTURE_H */
@@ -75,7 +75,9 @@ void update_all_cycles(long cycles) {
         update_timers(cycles); 
         long updated_cycles = update_graphics(cycles); 
         sound_add_cycles(updated_cycles);
-        inc_serial_cycles(updated_cycles);
+        if (serial_transfer_in_progress) {
+            inc_serial_cycles(updated_cycles);
+        }
 }
 
 
@@ -246,12 +248,12 @@ void invalid_op(){
  static void LDH_A_n() { 
     update_all_cycles(4);
     uint8_t val = IMMEDIATE_8_BIT;   
-    reg.A = ((val >= 0x10) && (val <= 0x3F)) ? read_apu(val | 0xFF00) : io_mem[val];
+    reg.A = io_read_mem(val);
     timer_cycles_passed = 4;
 }
 
 /* Put memory address $FF00 + C into A */
- static void LDH_A_C() {reg.A = ((reg.C >= 0x10) && (reg.C <= 0x3F)) ? read_apu(reg.C | 0xFF00) : io_mem[reg.C];}
+ static void LDH_A_C() {reg.A = io_read_mem(reg.C);}
 
 /* Put A into memory address $FF00 + C */
  static void LDH_C_A() {io_write_mem(reg.C, reg.A);}
@@ -675,7 +677,10 @@ void invalid_op(){
         int switch_speed = speed & BIT_0;
 
         if (switch_speed) {
+            // Timers count at the old speed up to the switch
+            sync_timers();
             cgb_speed = !(speed & BIT_7);
+            sync_timers();
             io_mem[KEY1_REG] = !(speed & BIT_7) * 0x80;
             // Actually stopping doesn't make sense, this needs to be double checked though
             stopped = 0;
@@ -1566,6 +1571,15 @@ void reset_cpu() {
     stopped = 0;
 }
 
+void set_boot_registers(uint16_t af, uint16_t bc, uint16_t de, uint16_t hl) {
+    reg.AF = af;
+    reg.BC = bc;
+    reg.DE = de;
+    reg.HL = hl;
+    reg.PC = 0x0100;
+    reg.SP = 0xFFFE;
+}
+
 
 
 void print_regs() {
@@ -21,6 +21,10 @@ void master_interrupts_enable();
 
 void reset_cpu();
 
+/* Start at the cartridge entry point 0x100 with the
+ * registers the boot ROM leaves behind */
+void set_boot_registers(uint16_t af, uint16_t bc, uint16_t de, uint16_t hl);
+
 
 /*  Executes current instruction and returns
  *  the number of machine cycles it took */
@@ -9,12 +9,14 @@
 #include "sound.h"
 #include "emu.h"
 #include "serial_io.h"
+#include "capture.h"
 #include <stdio.h>
 
 #include "../non_core/joypad.h"
 #include "../non_core/files.h"
 #include "../non_core/logger.h"
 #include "../non_core/debugger.h"
+#include "../non_core/serial_io_transfer.h"
 
 #ifdef EFIAPI
 #include "../platforms/UEFI/libs.h"
@@ -31,15 +33,10 @@
 #include <Protocol/LoadedImage.h>
 #include <Protocol/EfiShellInterface.h>
 #include <Protocol/EfiShellParameters.h>
-#define PB_FOPEN uefi_fopen
-#define PB_FSEEK uefi_fseek
-#define PB_FREAD uefi_fread
-#define PB_FCLOSE uefi_fclose
-#else
-#define PB_FOPEN fopen
-#define PB_FSEEK fseek 
-#define PB_FREAD fread
-#define PB_FCLOSE fclose
+#endif
+
+#ifdef STARTUP_PROFILE
+#include "../non_core/get_time.h"
 #endif
 
 int quit = 0;
@@ -55,51 +52,74 @@ int debug = 0;
 int step_count = STEPS_OFF;
 int breakpoint = BREAKPOINT_OFF;
 
+#ifdef STARTUP_PROFILE
+#define STARTUP_PHASES 8
+
+/* Times at the end of each phase of init_emu, only logged once
+ * it's finished so logging doesn't count towards them */
+static struct {
+    char const *name;
+    uint64_t time;
+} startup_phases[STARTUP_PHASES];
+static int startup_phase_count = 0;
+
+static void startup_phase(char const *name) {
+    if (startup_phase_count < STARTUP_PHASES) {
+        startup_phases[startup_phase_count].name = name;
+        startup_phases[startup_phase_count++].time = get_time_micro();
+    }
+}
+
+static void log_startup_phases() {
+    for (int i = 1; i < startup_phase_count; i++) {
+        log_message(LOG_INFO, "Startup: %s %dus\n", startup_phases[i].name,
+                    (int)(startup_phases[i].time - startup_phases[i - 1].time));
+    }
+    log_message(LOG_INFO, "Startup: total %dus\n",
+                (int)(startup_phases[startup_phase_count - 1].time - startup_phases[0].time));
+}
+#else
+#define startup_phase(name)
+#define log_startup_phases()
+#endif
+
 /* Intialize emulator with given ROM file, and
  * specify whether or not debug mode is active
  * (0 for OFF, any other value is on)
+ * If skip_boot is set the boot ROM isn't run, the cartridge
+ * starts with the state the boot ROM would have left
  *
  * returns 1 if successfully initialized, 0
  * otherwise */
-int init_emu(const char *file_path, int debugger, int dmg_mode, ClientOrServer cs) {
+int init_emu(const char *file_path, int debugger, int dmg_mode, int skip_boot, ClientOrServer cs) {
+
+    startup_phase("start");
 
-    uint8_t rom_header[0x50];
-    
     //Start logger
     set_log_level(LOG_INFO);
 
     log_message(LOG_INFO, "About to open file %s\n", file_path);
-    FILE *file;
-    if (!(file = PB_FOPEN(file_path,"rb"))) {
-        log_message(LOG_ERROR, "Error opening file %s\n", file_path);
-        return 0;
-    }
-
-    if ((PB_FSEEK(file, 0x100, SEEK_SET) != 0) 
-        || (PB_FREAD(rom_header, 1, sizeof(rom_header), file) != sizeof(rom_header))) {
-        log_message(LOG_ERROR, "Error reading ROM header info\n");
-        fclose(file);
-        return 0;    
-    };
-    PB_FCLOSE(file);
-
-	log_message(LOG_INFO, "ROM Header loaded %s\n", file_path);
-    if (!load_rom(file_path, rom_header, dmg_mode)) {
+    if (!load_rom(file_path, dmg_mode)) {
         log_message(LOG_ERROR, "failed to initialize GB memory\n");
         return 0;
     }
+    startup_phase("load ROM");
 
     if (!init_gfx()) {
         log_message(LOG_ERROR, "Failed to initialize graphics\n");
         return 0;
     }
+    startup_phase("graphics");
 
     if (!setup_serial_io(cs, 5000)) {
         log_message(LOG_INFO, "No client or server created\n");
     }
+    startup_phase("serial io");
+
     init_joypad();
     init_apu(); // Initialize sound
     reset_cpu();
+    startup_phase("joypad, sound and cpu");
 
     if (debugger) {
         debug = 1;
@@ -107,6 +127,11 @@ int init_emu(const char *file_path, int debugger, int dmg_mode, ClientOrServer c
 
     cgb_features = is_colour_compatible() || is_colour_only();
 
+    if (skip_boot) {
+        skip_boot_rom();
+    }
+    startup_phase("boot");
+
     //Log ROM info
     char name_buf[100];
     int i;
@@ -128,6 +153,8 @@ int init_emu(const char *file_path, int debugger, int dmg_mode, ClientOrServer c
     log_message(LOG_INFO, "Has Gameboy Color features: %s\n", is_colour_compatible() || is_colour_only() ? "Yes":"No");
     log_message(LOG_INFO,"Gameboy Color Only Game:%s\n", is_colour_only() ? "Yes":"No");
     log_message(LOG_INFO,"Super Gameboy Features:%s\n", has_sgb_features() ? "Yes":"No");
+    startup_phase("ROM info");
+    log_startup_phases();
 
 	
     return 1;
@@ -154,7 +181,9 @@ void run_one_frame() {
             long current_cycles = cgb_speed ? 2 : 4;
             update_timers(current_cycles);
             sound_add_cycles(current_cycles);
-            inc_serial_cycles(current_cycles);
+            if (serial_transfer_in_progress) {
+                inc_serial_cycles(current_cycles);
+            }
 
             // If Key pressed in "stop" mode, then gameboy is "unstopped"
             if (stopped) {
@@ -180,9 +209,10 @@ void run_one_frame() {
 		if (cycles > 15000) {
 		#endif
             quit |= update_keys();
+            link_sync(cycles);
             cycles = 0;
         }
-        skip_bug = handle_interrupts();
+        skip_bug = interrupt_pending ? handle_interrupts() : 0;
 
         if (debug && step_count > 0 && --step_count == 0) {
             int flags = get_command();
@@ -214,5 +244,24 @@ void run() {
 }
 
 void finalize_emu() {
+#ifdef VIDEO_CAPTURE
+    stop_capture();
+#endif
+    set_present_thread(0);
+    set_frame_export(NULL);
+    set_render_thread(0);
+
+    unsigned long rows_rendered, rows_skipped;
+    get_row_skip_stats(&rows_rendered, &rows_skipped);
+    log_message(LOG_INFO, "Unchanged rows skipped: %d of %d\n", (int)rows_skipped, (int)rows_rendered);
+
+    unsigned long split_rows;
+    get_raster_stats(&rows_rendered, &split_rows);
+    log_message(LOG_INFO, "Rows rendered in segments: %d of %d\n", (int)split_rows, (int)rows_rendered);
+
+    unsigned long frames_rendered, frames_batched;
+    get_batch_stats(&frames_rendered, &frames_batched);
+    log_message(LOG_INFO, "Frames rendered in one batch: %d of %d\n", (int)frames_batched, (int)frames_rendered);
+
     teardown_memory();
 }
@@ -6,10 +6,12 @@
 /* Intialize emulator with given ROM file, and
  * specify whether or not debug mode is active
  * (0 for OFF, any other value is on) 
+ * If skip_boot is set the boot ROM isn't run, the cartridge
+ * starts with the state the boot ROM would have left
  *
  * returns 1 if successfully initialized, 0
  * otherwise */
-int init_emu(const char *file_path, int debugger, int dmg_mode, ClientOrServer cs);
+int init_emu(const char *file_path, int debugger, int dmg_mode, int skip_boot, ClientOrServer cs);
 
 // Free up all resources, preparing to exit
 void finalize_emu();
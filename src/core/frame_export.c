@@ -0,0 +1,96 @@
+#ifdef FRAME_EXPORT
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frame_export.h"
+
+#include "../non_core/logger.h"
+
+int create_frame_export(Frame_Export *fe, char const *name) {
+
+    if (strlen(name) >= sizeof(fe->name)) {
+        log_message(LOG_ERROR, "Frame export name too long: %s\n", name);
+        return 0;
+    }
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        log_message(LOG_ERROR, "Unable to create frame export: %s\n", name);
+        return 0;
+    }
+
+    if (ftruncate(fd, sizeof(Frame_Export_Segment)) != 0) {
+        log_message(LOG_ERROR, "Unable to size frame export: %s\n", name);
+        close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+
+    void *mem = mmap(NULL, sizeof(Frame_Export_Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        log_message(LOG_ERROR, "Unable to map frame export: %s\n", name);
+        shm_unlink(name);
+        return 0;
+    }
+
+    // A new segment is zero filled, readers check the magic number last
+    fe->segment = mem;
+    Frame_Export_Header *header = &fe->segment->header;
+    header->version = FRAME_EXPORT_VERSION;
+    header->width = FRAME_EXPORT_WIDTH;
+    header->height = FRAME_EXPORT_HEIGHT;
+    __atomic_store_n(&header->magic, FRAME_EXPORT_MAGIC, __ATOMIC_RELEASE);
+
+    strcpy(fe->name, name);
+    fe->slot = 0;
+    fe->writing = 0;
+
+    log_message(LOG_INFO, "Exporting frames to shared memory %s\n", name);
+    return 1;
+}
+
+void destroy_frame_export(Frame_Export *fe) {
+
+    if (fe->segment == NULL) {
+        return;
+    }
+    munmap(fe->segment, sizeof(Frame_Export_Segment));
+    shm_unlink(fe->name);
+    fe->segment = NULL;
+}
+
+uint32_t *begin_export_frame(Frame_Export *fe) {
+
+    Frame_Export_Header *header = &fe->segment->header;
+    if (!fe->writing) {
+        // Readers must see the slot as being written before any pixels change
+        __atomic_store_n(&header->slot_sequence[fe->slot], header->slot_sequence[fe->slot] + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        fe->writing = 1;
+    }
+    return fe->segment->pixels[fe->slot];
+}
+
+void finish_export_frame(Frame_Export *fe) {
+
+    if (!fe->writing) {
+        return;
+    }
+
+    Frame_Export_Header *header = &fe->segment->header;
+    uint64_t frame = header->frames + 1;
+    header->slot_frame[fe->slot] = frame;
+    __atomic_store_n(&header->slot_sequence[fe->slot], header->slot_sequence[fe->slot] + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->frames, frame, __ATOMIC_RELEASE);
+
+    fe->slot = (fe->slot + 1) % FRAME_EXPORT_SLOTS;
+    fe->writing = 0;
+}
+
+#endif /* FRAME_EXPORT */
@@ -0,0 +1,63 @@
+#ifndef FRAME_EXPORT_H
+#define FRAME_EXPORT_H
+
+#include <stdint.h>
+
+/* Frames are rendered straight into a POSIX shared memory segment so
+ * other processes can read the screen without any copies being made.
+ *
+ * The segment holds 2 frame slots which are written alternately, frame n
+ * (counting from 1) is in slot (n - 1) % 2. Each slot has a sequence
+ * number which is odd while the slot is being written, a reader copying
+ * or reading a slot in place should check the sequence number is even and
+ * unchanged before and after. The other slot holds the latest frame
+ * while one is being written, so readers have a whole frame to read it.
+ *
+ * Pixels are 32 bit 0xXXRRGGBB values, GB_PIXELS_X per row. */
+#define FRAME_EXPORT_MAGIC 0x58464247 // "GBFX"
+#define FRAME_EXPORT_VERSION 1
+#define FRAME_EXPORT_SLOTS 2
+#define FRAME_EXPORT_WIDTH 160
+#define FRAME_EXPORT_HEIGHT 144
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint64_t frames; // Number of frames finished, 0 if none yet
+    uint64_t slot_sequence[FRAME_EXPORT_SLOTS];
+    uint64_t slot_frame[FRAME_EXPORT_SLOTS]; // Frame number held by each slot
+    uint8_t padding[8]; // Pixels start on a 64 byte boundary
+} Frame_Export_Header;
+
+typedef struct {
+    Frame_Export_Header header;
+    uint32_t pixels[FRAME_EXPORT_SLOTS][FRAME_EXPORT_WIDTH * FRAME_EXPORT_HEIGHT];
+} Frame_Export_Segment;
+
+typedef struct {
+    Frame_Export_Segment *segment;
+    char name[64];
+    int slot; // Slot being written or next to be written
+    int writing;
+} Frame_Export;
+
+/* Create the shared memory segment with the given name (e.g. "/uefiboy0"),
+ * replacing any with the same name.
+ * returns 1 if successful, 0 otherwise */
+int create_frame_export(Frame_Export *fe, char const *name);
+
+// Unmap and remove the shared memory segment
+void destroy_frame_export(Frame_Export *fe);
+
+/* Start writing the next frame, readers are told its slot is being
+ * written. Calling again without finishing continues the same frame.
+ * returns the slot's pixels, which keep their contents from the frame
+ * written 2 frames before */
+uint32_t *begin_export_frame(Frame_Export *fe);
+
+// Publish the frame being written as the latest frame
+void finish_export_frame(Frame_Export *fe);
+
+#endif /* FRAME_EXPORT_H */
@@ -4,15 +4,21 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "mmu/memory.h"
 #include "memory_layout.h"
 #include "graphics.h"
 #include "sprite_priorities.h"
+#include "render_thread.h"
+#include "present_thread.h"
+#include "frame_export.h"
+#include "capture.h"
 #include "bits.h"
 #include "rom_info.h"
 
 #include "../non_core/graphics_out.h"
+#include "../shared_libs/scaler.h"
 #include "../non_core/framerate.h"
 #include "../non_core/logger.h"
 
@@ -21,11 +27,41 @@
 #define VITA_PIX_Y 544
 #endif
 
-static int old_buffer[144][160];
-static int cgb_bg_prio[144][160];
+/* The row being rendered, one packed byte per pixel which is
+ * converted to colours once the row is complete.
+ *
+ * Packed pixel format: bits 0-1 colour id, bits 2-4 CGB palette number,
+ * bit 5 set for sprite pixels, bit 7 CGB background priority */
+#define PIXEL_PALETTE_SHIFT 2
+#define PIXEL_SPRITE BIT_5
+#define PIXEL_BG_PRIO BIT_7
+#define PIXEL_COLOR_INDEX 0x3F // Bits selecting the pixel's colour from line_colors
+
+static uint8_t line_buffer[160];
+// Colour of every colour id/palette/sprite combination for the current row
+static uint32_t line_colors[0x40];
+static uint64_t line_colors_key = UINT64_MAX;
 
 // Stores 32 bit color representation of the screen_buffer
 static uint32_t rgb_pixels[144 * 160];
+/* Buffer rows are rendered into, either rgb_pixels, the back buffer
+ * of the presentation thread while it's running or a slot of the
+ * shared memory frame export */
+static uint32_t *frame_pixels = rgb_pixels;
+#ifdef VIDEO_CAPTURE
+// Whether capture was running when the frame started, so it's rendered into rgb_pixels
+static int capturing_frame = 0;
+#endif
+#ifdef FRAME_EXPORT
+static Frame_Export frame_export;
+#endif
+
+/* Rows are written straight to the platform's scaled screen
+ * instead of rgb_pixels if it provides a target */
+static Screen_Target screen_target;
+static int direct_output = 0;
+static int target_frames = 0; // Rendered to the screen target since every row was redrawn
+static uint32_t row_colors[160];
 
 // Stores the processed bg palette colours
 static uint32_t rendered_bg_palette[0x20];
@@ -35,11 +71,99 @@ static uint8_t row;
 static uint8_t lcd_ctrl;
 static uint8_t *bg_palette;
 static uint8_t *sprite_palette;
+static bool bg_palette_changed = true;
+static bool sprite_palette_changed = true;
 
 int frame_drawn = 0;
 
+static Render_Policy render_policy = RENDER_EVERY_FRAME;
+static unsigned render_interval = 1;
+static unsigned frames_until_render = 0;
+static int frame_requested = 0;
+static int render_frame = 1; // Whether the current frame is being rendered
+
+/* The state rows are rendered from, either live emulator memory or
+ * a line record queued for the render thread */
+#define LCD_REG(r) (lcd_regs[(r) - LCDC_REG])
+static uint8_t const *lcd_regs; // LCDC_REG - WX_REG
+static uint8_t const *oam;
+static uint8_t const *sprite_order; // Sprite numbers, highest priority first
+static uint8_t const *vram_pages[2][VRAM_PAGES];
+static int booting;
+
+static uint8_t live_sprite_order[MAX_SPRITES];
+// Palettes copied from line records, used while the render thread is running
+static uint8_t bg_palette_copy[0x40];
+static uint8_t sprite_palette_copy[0x40];
+
+/* Pre-rendered background maps (0x9800 and 0x9C00), each a 256x256 buffer
+ * of packed pixels (the same format as line_buffer) which both the
+ * background and window are copied from. The map is split into 32x32 cells
+ * (one per tile map entry), cells are re-rendered lazily when their tile map
+ * entry or CGB attributes are written to, or the tile data they were rendered
+ * from has changed. */
+
+#define MAP_CELLS (32 * 32)
+#define TILE_COUNT 384 // Tiles per VRAM bank
+/* Cells re-rendered more than once in a frame before the cache
+ * is considered stale, and the rest of the frame is rendered directly */
+#define STALE_CELL_LIMIT 64
+
+typedef struct {
+    uint8_t pixels[256][256];
+    uint16_t cell_tile[MAP_CELLS]; // Tile (bank * TILE_COUNT + tile no) each cell was rendered from
+    uint32_t cell_version[MAP_CELLS]; // Version of the tile when the cell was rendered
+    uint32_t cell_frame[MAP_CELLS]; // Frame the cell was last rendered
+    uint8_t cell_dirty[MAP_CELLS];
+    int mode; // Tile data select and CGB attribute mode the map was rendered with
+} BG_Map_Cache;
+
+static BG_Map_Cache bg_map_cache[2];
+static uint32_t tile_versions[2 * TILE_COUNT]; // Incremented on every tile data write
+/* Signature of everything used to render each row the last time it was
+ * rendered into a buffer, rows with an unchanged signature are left as they
+ * are. Each presentation buffer holds a different frame so has its own */
+typedef struct {
+    uint64_t signature[144];
+    uint8_t valid[144];
+} Row_Signatures;
+// rgb_pixels/screen target, each presentation buffer then each frame export slot
+#define EXPORT_ROWS (1 + PRESENT_BUFFERS)
+static Row_Signatures buffer_rows[EXPORT_ROWS + FRAME_EXPORT_SLOTS];
+static Row_Signatures *row_signatures = &buffer_rows[0];
+static uint32_t palette_version = 0; // Incremented whenever CGB palettes change
+static unsigned long rows_rendered = 0;
+static unsigned long rows_skipped = 0;
+
+// Writes to the LCD registers during mode 3 of raster_row
+static Raster_Writes raster_writes;
+static uint8_t raster_row;
+static unsigned long rows_split = 0; // Rows rendered in segments
+
+/* Rows aren't rendered as they're reached but all at once at the end of
+ * the frame, unless something they're rendered from is about to be
+ * modified. Then the rows so far are rendered before the write */
+static int batch_rows = 1;
+int deferred_rows = 0;
+static uint8_t deferred_row_nos[144];
+static int frame_batched = 1; // No rows were rendered before the end of the frame
+static unsigned long frames_batched = 0;
+static unsigned long frames_rendered = 0;
+
+static int bg_cache_enabled = 1;
+static int bg_cache_stale = 0;
+static unsigned stale_cells = 0;
+static uint32_t frame_count = 1;
+
 static void refresh_gbc_bg_palettes();
 static void refresh_gbc_sprite_palettes();
+static void use_live_state();
+static void select_frame_buffer();
+
+static inline uint8_t vram_read(uint16_t addr, int bank) {
+    addr -= TILE_SET_0_START;
+    return vram_pages[bank][addr / VRAM_PAGE_SIZE][addr % VRAM_PAGE_SIZE];
+}
 
 /*  A color in GBC is represented by 3 5 bit numbers stored within 2 bytes.*/
 typedef struct {uint8_t red; uint8_t green; uint8_t blue;} GBC_color;
@@ -47,11 +171,15 @@ typedef struct {uint8_t red; uint8_t green; uint8_t blue;} GBC_color;
 int init_gfx() {
    
     start_framerate(DEFAULT_FPS); 
-    bg_palette = get_bg_palette();
-    sprite_palette = get_sprite_palette();
+    use_live_state();
     refresh_gbc_bg_palettes();
     refresh_gbc_sprite_palettes();
 
+    for (int i = 0; i < 2; i++) {
+        memset(bg_map_cache[i].cell_dirty, 1, MAP_CELLS);
+        bg_map_cache[i].mode = -1;
+    }
+
 #ifdef PSVITA //VITA
 	int result = init_screen(VITA_PIX_X, VITA_PIX_Y, rgb_pixels);
 #else
@@ -72,7 +200,7 @@ static uint32_t cgb_color_to_rgb(uint16_t c) {
 
 static void refresh_gbc_bg_palettes() {
 
-    if (bg_palette_dirty) {
+    if (bg_palette_changed) {
    
         for (int i = 0; i < 0x20; i++) {
             // Obtain 15 bit gameboy color for background palette
@@ -80,13 +208,14 @@ static void refresh_gbc_bg_palettes() {
             rendered_bg_palette[i] = cgb_color_to_rgb(gb_color);
         }
     
-        bg_palette_dirty = false;
+        bg_palette_changed = false;
+        palette_version++;
     }
 }
 
 static void refresh_gbc_sprite_palettes() {
 
-    if (sprite_palette_dirty) {
+    if (sprite_palette_changed) {
    
         for (int i = 0; i < 0x20; i++) {
             // Obtain 15 bit gameboy color for sprite palette
@@ -94,7 +223,8 @@ static void refresh_gbc_sprite_palettes() {
             rendered_sprite_palette[i] = cgb_color_to_rgb(gb_color);
         }
     
-        sprite_palette_dirty = false;
+        sprite_palette_changed = false;
+        palette_version++;
     }
 }
 
@@ -127,39 +257,19 @@ static uint32_t get_dmg_bg_col(int c) {
 
 
 
-static void draw_sprite_row() {
-   
-    refresh_gbc_sprite_palettes();
-
-    // 8x16 or 8x8
-    int height = lcd_ctrl & BIT_2 ? 16 : 8;
-
-    uint8_t obp_0 = io_mem[OBP0_REG]; 
-    uint8_t obp_1 = io_mem[OBP1_REG]; 
-    int palletes[2][4];
-
-    //Calculate both color palletes
-    palletes[0][0] =  obp_0  & 0x3;
-    palletes[0][1] = (obp_0 >> 2) & 0x3;
-    palletes[0][2] = (obp_0 >> 4) & 0x3;
-    palletes[0][3] = (obp_0 >> 6) & 0x3;
-
-    palletes[1][0] = obp_1  & 0x3;
-    palletes[1][1] = (obp_1 >> 2) & 0x3;
-    palletes[1][2] = (obp_1 >> 4) & 0x3;
-    palletes[1][3] = (obp_1 >> 6) & 0x3;
+/* Obtain the sprites on the current row in order of priority, highest
+ * priority first, returns the number of sprites */
+static int get_row_sprites(int sprite_nos[10], int height) {
 
-    Sprite_Iterator si = create_sprite_iterator();
-    int sprite_no;
     int sprite_count = 0;
-    int sprite_nos[10];
 
     /*40 Sprites, loop through from least priority to most priority
       limited to 10 a line */
-    while((sprite_no = sprite_iterator_next(&si)) != -1 && sprite_count < 10)  {
+    for (int i = 0; i < MAX_SPRITES && sprite_count < 10; i++) {
         
-        int16_t y_pos = oam_get_mem((sprite_no * 4)) - 16;
-        int16_t x_pos = oam_get_mem((sprite_no * 4) + 1) - 8;
+        int sprite_no = sprite_order[i];
+        int16_t y_pos = oam[sprite_no * 4] - 16;
+        int16_t x_pos = oam[(sprite_no * 4) + 1] - 8;
         
         //If sprite doesn't intersect current line, no need to draw
         if (y_pos > row || row >= y_pos + height || x_pos >= 160) {
@@ -170,13 +280,25 @@ static void draw_sprite_row() {
         sprite_count++;
     }
 
+    return sprite_count;
+}
+
+
+static void draw_sprite_row() {
+
+    // 8x16 or 8x8
+    int height = lcd_ctrl & BIT_2 ? 16 : 8;
+
+    int sprite_nos[10];
+    int sprite_count = get_row_sprites(sprite_nos, height);
+
     for (int i = sprite_count - 1; i >= 0; i--) {
          int sprite_no  = sprite_nos[i];
 
-         int16_t y_pos = oam_get_mem((sprite_no * 4)) - 16;
-         int16_t x_pos = oam_get_mem((sprite_no * 4) + 1) - 8;
-         uint8_t tile_no = oam_get_mem((sprite_no * 4) + 2);
-         uint8_t attributes = oam_get_mem((sprite_no * 4) + 3);
+         int16_t y_pos = oam[sprite_no * 4] - 16;
+         int16_t x_pos = oam[(sprite_no * 4) + 1] - 8;
+         uint8_t tile_no = oam[(sprite_no * 4) + 2];
+         uint8_t attributes = oam[(sprite_no * 4) + 3];
     
         
          if (height == 16) {
@@ -188,21 +310,13 @@ static void draw_sprite_row() {
         int y_flip = attributes & BIT_6;
         
         int v_bank = 0;
-        int cgb_palette_number = 0;
-        if (cgb) {
-           
-            if (is_booting || cgb_features) {
-                cgb_palette_number = attributes & 0x7;
-                v_bank = !!(attributes & BIT_3);
-            }            
-            // DMG mode in CGB, there is only 2 predefined BG palettes which the
-            // boot rom initialized at startup containing 3 colors each
-            // and only the original vram bank is available
-            else {
-                cgb_palette_number = !!(attributes & BIT_4);
-                v_bank = 0;
-            }
+        int palette_no = (attributes & BIT_4) ? 1 : 0;
+        if (cgb && (booting || cgb_features)) {
+            palette_no = attributes & 0x7;
+            v_bank = !!(attributes & BIT_3);
         }
+        // DMG mode in CGB only has the 2 predefined sprite palettes the
+        // boot rom initialized and only the original vram bank is available
 
         uint16_t tile_loc = TILE_SET_0_START + (tile_no * 16);
         
@@ -210,10 +324,11 @@ static void draw_sprite_row() {
         // need to obtain row relative to bottom of sprite
         uint8_t line =  (!y_flip) ? row - y_pos  : height + y_pos - row -1;
         uint16_t line_offset = 2 * line;
-        uint8_t high_byte = get_vram(tile_loc + line_offset, v_bank);
-        uint8_t low_byte =  get_vram(tile_loc + line_offset + 1, v_bank);
+        uint8_t high_byte = vram_read(tile_loc + line_offset, v_bank);
+        uint8_t low_byte =  vram_read(tile_loc + line_offset + 1, v_bank);
 
-        int pal_no = (attributes & BIT_4) ? 1 : 0;
+        int sprite_prio  = !(attributes & 0x80);
+        uint8_t pixel_info = PIXEL_SPRITE | (palette_no << PIXEL_PALETTE_SHIFT);
         
         // Draw all pixels in current line of sprite
         for (int x = 0; x < 8; x++) {
@@ -225,60 +340,193 @@ static void draw_sprite_row() {
             int bit_0 = (low_byte >> bit_pos) & 0x1;
             int bit_1 = (high_byte >> bit_pos) & 0x1;
             uint8_t color_id = (bit_0 << 1) | bit_1;
-            int sprite_prio  = !(attributes & 0x80);
+            uint8_t below = line_buffer[x_pos + x];
             
             // If priority bit not set but background is transparent and
             // current pixel isn't transparent draw. Otherwise if priority set
             // as long as pixel isn't transparent, draw it
-            uint8_t final_color_id = palletes[pal_no][color_id]; 
+            if (color_id == 0) {
+                continue;
+            }
             if (!sprite_prio) {
-                if (color_id != 0 && (!cgb_bg_prio[row][x_pos + x] && !old_buffer[row][x_pos + x])) {
-                    if (!cgb || !(is_booting || cgb_features)) {
-                       rgb_pixels[(row * GB_PIXELS_X) + x_pos + x] = rendered_sprite_palette[(pal_no * 4) + final_color_id];
-                       old_buffer[row][x_pos + x] = color_id;
-                   } else {                        
-                       rgb_pixels[(row * GB_PIXELS_X) + x_pos + x] = rendered_sprite_palette[(cgb_palette_number * 4) + color_id];
-                       old_buffer[row][x_pos + x] = color_id;
-                   }
-                }               
-            } else  {
-                if (color_id != 0 && (!cgb || (!cgb_bg_prio[row][x_pos + x] || !old_buffer[row][x_pos + x]))) {
-                    if (!cgb || !(is_booting || cgb_features)) {
-                       rgb_pixels[(row * GB_PIXELS_X) + x_pos + x] = get_dmg_sprite_col(final_color_id, pal_no);
-                       old_buffer[row][x_pos + x] = color_id;
-                   } else {
-                       rgb_pixels[(row * GB_PIXELS_X) + x_pos + x] = rendered_sprite_palette[(cgb_palette_number * 4) + color_id];
-                       old_buffer[row][x_pos + x] = color_id;
-                   }
+                if ((below & PIXEL_BG_PRIO) || (below & 0x3)) {
+                    continue;
                 }
-            } 
-             
+            } else if (cgb && (below & PIXEL_BG_PRIO) && (below & 0x3)) {
+                continue;
+            }
+
+            // Keep the background's priority for sprites drawn below this one
+            line_buffer[x_pos + x] = color_id | pixel_info | (below & PIXEL_BG_PRIO);
+        }
+    }
+}
+
+
+
+void vram_written(uint16_t addr, int bank) {
+#ifdef RENDER_THREAD
+    // The render thread keeps track of changes to its own snapshots
+    if (render_thread_running()) {
+        render_thread_vram_written(addr, bank);
+        return;
+    }
+#endif
+    if (addr < BG_MAP_DATA0_START) {
+        tile_versions[(bank * TILE_COUNT) + ((addr - TILE_SET_0_START) >> 4)]++;
+    } else {
+        // Either the tile number (bank 0) or CGB attributes (bank 1) for a cell
+        bg_map_cache[addr >= BG_MAP_DATA1_START].cell_dirty[addr & (MAP_CELLS - 1)] = 1;
+    }
+}
+
+void vram_range_written(uint16_t addr, unsigned len, int bank) {
+    uint16_t end = addr + len;
+    // Once per tile, each background map byte is its own cell
+    while (addr < end) {
+        vram_written(addr, bank);
+        addr = (addr < BG_MAP_DATA0_START) ? (addr | 0xF) + 1 : addr + 1;
+    }
+}
+
+void set_bg_cache(int enabled) {
+    bg_cache_enabled = enabled;
+}
+
+// Render all 8 lines of a background map cell into the cache
+static void render_cache_cell(BG_Map_Cache *cache, uint16_t tile_mem, uint16_t bg_mem, int cell) {
+
+    int tile_no = vram_read(bg_mem + cell, 0);
+
+    int tile_attributes = 0;
+    int palette_no = 0;
+    int tile_vram_bank_no = 0;
+    int bg_prio = 0;
+
+    if (cgb) {
+        tile_attributes = vram_read(bg_mem + cell, 1);
+
+        if (booting || cgb_features) {
+            palette_no = tile_attributes & 0x7;
+            tile_vram_bank_no = !!(tile_attributes & BIT_3);
+            bg_prio = tile_attributes & BIT_7;
         }
     }
+
+    // Signed tile no, need to convert to offset
+    if (tile_mem == TILE_SET_1_START) {
+        tile_no = (tile_no & 127) - (tile_no & 128) + 128;
+    }
+
+    int tile_loc = tile_mem + (tile_no * 16); //Location of tile in memory
+    int tile = (tile_vram_bank_no * TILE_COUNT) + ((tile_loc - TILE_SET_0_START) >> 4);
+
+    int vert_flip = tile_attributes & BIT_6;
+    int horiz_flip = tile_attributes & BIT_5;
+    uint8_t pixel_info = (palette_no << PIXEL_PALETTE_SHIFT) | (bg_prio ? PIXEL_BG_PRIO : 0);
+
+    for (int y = 0; y < 8; y++) {
+        int line_offset = (vert_flip ? (7 - y) : y) << 1;
+        int byte0 = vram_read(tile_loc + line_offset, tile_vram_bank_no);
+        int byte1 = vram_read(tile_loc + line_offset + 1, tile_vram_bank_no);
+
+        uint8_t *pixels = &cache->pixels[((cell >> 5) << 3) + y][(cell & 31) << 3];
+        for (int j = 0; j < 8; j++) {
+            int bit_1 = (byte1 >> (horiz_flip ? j : (7 - j))) & 0x1;
+            int bit_0 = (byte0 >> (horiz_flip ? j : (7 - j))) & 0x1;
+            pixels[j] = ((bit_1 << 1) | bit_0) | pixel_info;
+        }
+    }
+
+    // Rendering the same cell twice in one frame means the map changed mid-frame
+    if (cache->cell_frame[cell] == frame_count) {
+        stale_cells++;
+    }
+
+    cache->cell_tile[cell] = tile;
+    cache->cell_version[cell] = tile_versions[tile];
+    cache->cell_frame[cell] = frame_count;
+    cache->cell_dirty[cell] = 0;
+}
+
+/* Ensure the given number of cells from the given cell row/column
+ * (wrapping around the map) in the cache are up to date, returns the
+ * cache for the map */
+static BG_Map_Cache *validate_cache_cells(uint16_t tile_mem, uint16_t bg_mem, int cell_row, int cell_col, int count) {
+
+    BG_Map_Cache *cache = &bg_map_cache[bg_mem == BG_MAP_DATA1_START];
+
+    // Tile data select or attribute mode changed, every cell needs re-rendering
+    int mode = (tile_mem == TILE_SET_1_START) | ((cgb && (booting || cgb_features)) << 1);
+    if (mode != cache->mode) {
+        memset(cache->cell_dirty, 1, MAP_CELLS);
+        cache->mode = mode;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int cell = (cell_row << 5) | ((cell_col + i) & 31);
+        if (cache->cell_dirty[cell] ||
+            cache->cell_version[cell] != tile_versions[cache->cell_tile[cell]]) {
+            render_cache_cell(cache, tile_mem, bg_mem, cell);
+        }
+    }
+
+    if (stale_cells > STALE_CELL_LIMIT) {
+        bg_cache_stale = 1;
+    }
+
+    return cache;
+}
+
+// Render the current row of the background from the background map cache
+static void draw_cached_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
+
+    uint8_t y_pos = row + LCD_REG(SCROLL_Y_REG);
+    uint8_t scroll_x = LCD_REG(SCROLL_X_REG);
+
+    // 21 cells cover the row unless it's tile aligned
+    BG_Map_Cache *cache = validate_cache_cells(tile_mem, bg_mem, y_pos >> 3, scroll_x >> 3,
+            (scroll_x & 0x7) ? 21 : 20);
+
+    // Copy the row from the map, wrapping around to the start if needed
+    int first_len = 256 - scroll_x;
+    if (first_len >= 160) {
+        memcpy(line_buffer, &cache->pixels[y_pos][scroll_x], 160);
+    } else {
+        memcpy(line_buffer, &cache->pixels[y_pos][scroll_x], first_len);
+        memcpy(line_buffer + first_len, &cache->pixels[y_pos][0], 160 - first_len);
+    }
 }
 
+// Render the current row of the window from the background map cache
+static void draw_cached_window_row(uint16_t tile_mem, uint16_t bg_mem) {
+
+    uint8_t win_y = LCD_REG(WY_REG);
+    int16_t win_x = LCD_REG(WX_REG) < 7 ? 0 : LCD_REG(WX_REG) - 7;
+
+    if (win_x > 159 || win_y > 143 || row < win_y) {
+        return;
+    }
+
+    int y_pos = row - win_y;
+    int width = 160 - win_x;
+    BG_Map_Cache *cache = validate_cache_cells(tile_mem, bg_mem, y_pos >> 3, 0, (width + 7) >> 3);
 
+    memcpy(line_buffer + win_x, &cache->pixels[y_pos][0], width);
+}
 
 
 static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
    
-    uint8_t bgp = io_mem[BGP_REF];
-    int pallete[4];
-    //Calculate color pallete
-    pallete[0] =  bgp  & 0x3;
-    pallete[1] = (bgp >> 2) & 0x3;
-    pallete[2] = (bgp >> 4) & 0x3;
-    pallete[3] = (bgp >> 6) & 0x3;
-    
-    uint8_t win_y = io_mem[WY_REG];//window_line;
+    uint8_t win_y = LCD_REG(WY_REG);//window_line;
     int16_t y_pos = row - win_y; // Get line 0 - 255 being drawn    
     uint16_t tile_row = (y_pos >> 3); // Get row 0 - 31 of tile
     
     /* WX_REG values < 7 are treated as WX_REG = 7, fixes clipping
      * of the podracer in star wars episode 1 - racer */
-    int16_t win_x = io_mem[WX_REG] < 7 ? 0 : io_mem[WX_REG] - 7;
+    int16_t win_x = LCD_REG(WX_REG) < 7 ? 0 : LCD_REG(WX_REG) - 7;
    
-    if (win_x > 159 || io_mem[WY_REG] > 143 || row < win_y) {
+    if (win_x > 159 || LCD_REG(WY_REG) > 143 || row < win_y) {
         return;
     }
     
@@ -302,7 +550,7 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
      
         int x_pos = start_x - win_x;
         int tile_col = (x_pos) >> 3;
-        int tile_no = get_vram0(bg_mem + (tile_row << 5)  + tile_col);
+        int tile_no = vram_read(bg_mem + (tile_row << 5)  + tile_col, 0);
         
         int tile_attributes = 0;
         int palette_no = 0;
@@ -310,9 +558,9 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
         int bg_prio = 0;
 
         if (cgb) {
-            tile_attributes = get_vram(bg_mem + (tile_row << 5) + tile_col, 1);
+            tile_attributes = vram_read(bg_mem + (tile_row << 5) + tile_col, 1);
 
-            if (is_booting || cgb_features) {
+            if (booting || cgb_features) {
                 palette_no = tile_attributes & 0x7;
                 tile_vram_bank_no = !!(tile_attributes & BIT_3);                
                  bg_prio = tile_attributes & BIT_7;
@@ -331,16 +579,20 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
             tile_no = (tile_no & 127) - (tile_no & 128) + 128;
         }
        
+        // If Verical flip flag set in CGB mode
+        int vert_flip = tile_attributes & BIT_6;
+
         int tile_loc = tile_mem + (tile_no * 16); //Location of tile in memory
-        int line_offset = (y_pos % 8) * 2; //Offset into tile of our line
+        int line_offset = (vert_flip ? (7 - (y_pos & 0x7)) : (y_pos & 0x7)) << 1; //Offset into tile of our line
         
 
-        int byte0 = get_vram(tile_loc + line_offset, tile_vram_bank_no);
-        int byte1 = get_vram(tile_loc + line_offset + 1, tile_vram_bank_no);
+        int byte0 = vram_read(tile_loc + line_offset, tile_vram_bank_no);
+        int byte1 = vram_read(tile_loc + line_offset + 1, tile_vram_bank_no);
        
          
         // If Horizontal flip flag set in CGB mode
         int horiz_flip = tile_attributes & BIT_5;
+        uint8_t pixel_info = (palette_no << PIXEL_PALETTE_SHIFT) | (bg_prio ? PIXEL_BG_PRIO : 0);
 
         // For each pixel in the line of the tile
         for (int j = pixel_x_start; j < 8; j++) {
@@ -350,14 +602,7 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
                 int bit_0 = (byte0 >> (horiz_flip ? j : (7 - j))) & 0x1;
                 int color_id = (bit_1 << 1) | bit_0;
 
-                if (!cgb || !(is_booting || cgb_features)) {
-                    rgb_pixels[(row * GB_PIXELS_X) + (i + j)] = get_dmg_bg_col(pallete[color_id]); 
-                    old_buffer[row][i + j] = color_id;
-                } else {
-                    rgb_pixels[(row * GB_PIXELS_X) + (i + j)] = rendered_bg_palette[(palette_no * 4) + color_id];
-                    old_buffer[row][i + j] = color_id;
-                    cgb_bg_prio[row][i + j] = bg_prio ? 1 : 0; 
-                }
+                line_buffer[i + j] = color_id | pixel_info;
             }
         }   
     }      
@@ -366,17 +611,9 @@ static void draw_tile_window_row(uint16_t tile_mem, uint16_t bg_mem) {
 
 //Render the supplied row with background tiles
 static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
-    uint8_t bgp = io_mem[BGP_REF];
-    int pallete[4];
-    //Calculate color pallete
-    pallete[0] =  bgp  & 0x3;
-    pallete[1] = (bgp >> 2) & 0x3;
-    pallete[2] = (bgp >> 4) & 0x3;
-    pallete[3] = (bgp >> 6) & 0x3;
-    
-    uint8_t y_pos = row + io_mem[SCROLL_Y_REG];  
+    uint8_t y_pos = row + LCD_REG(SCROLL_Y_REG);  
     int tile_row = y_pos >> 3; // Get row 0 - 31 of tile
-    uint8_t scroll_x = io_mem[SCROLL_X_REG];
+    uint8_t scroll_x = LCD_REG(SCROLL_X_REG);
    
     int skew_left = scroll_x & 0x7;
     int skew_right = (8 - skew_left) & 0x7;
@@ -387,7 +624,7 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
 
         uint8_t x_pos = i + scroll_x;
         int tile_col = x_pos >> 3;
-        int tile_no = get_vram0(bg_mem + (tile_row << 5) + tile_col);
+        int tile_no = vram_read(bg_mem + (tile_row << 5) + tile_col, 0);
 
         int tile_attributes = 0;
         int palette_no = 0;
@@ -395,9 +632,9 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
         int bg_prio = 0;
 
         if (cgb) {
-            tile_attributes = get_vram1(bg_mem + (tile_row << 5) + tile_col);
+            tile_attributes = vram_read(bg_mem + (tile_row << 5) + tile_col, 1);
             
-            if (is_booting || cgb_features) {
+            if (booting || cgb_features) {
                 palette_no = tile_attributes & 0x7;
                 tile_vram_bank_no = !!(tile_attributes & BIT_3);           
                 bg_prio = tile_attributes & BIT_7;
@@ -422,12 +659,13 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
         int tile_loc = tile_mem + (tile_no * 16); //Location of tile in memory
         int line_offset = (vert_flip ? (7 - (y_pos & 0x7)) : (y_pos & 0x7)) << 1; //Offset into tile of our line
             
-        int byte0 = get_vram(tile_loc + line_offset, tile_vram_bank_no);
-        int byte1 = get_vram(tile_loc + line_offset + 1, tile_vram_bank_no);
+        int byte0 = vram_read(tile_loc + line_offset, tile_vram_bank_no);
+        int byte1 = vram_read(tile_loc + line_offset + 1, tile_vram_bank_no);
 
 
         // If Horizontal flip flag set in CGB mode
         int horiz_flip = tile_attributes & BIT_5;
+        uint8_t pixel_info = (palette_no << PIXEL_PALETTE_SHIFT) | (bg_prio ? PIXEL_BG_PRIO : 0);
         
         //Render entire tile row
         for (int j = 0; j < 8; j++) {
@@ -438,15 +676,7 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
                 int bit_0 = (byte0 >> (horiz_flip ? j : (7 - j))) & 0x1;
                 int color_id = (bit_1 << 1) | bit_0;
 
-                if (!cgb || !(is_booting || cgb_features)) {
-                    rgb_pixels[(GB_PIXELS_X * row) + (i + j)] = get_dmg_bg_col(pallete[color_id]); 
-                    old_buffer[row][i + j] = color_id;
-                } else {
-                    rgb_pixels[(row * GB_PIXELS_X) + (i + j)] = rendered_bg_palette[(palette_no * 4) + color_id];
-                    old_buffer[row][i + j] = color_id;
-                    cgb_bg_prio[row][i + j] = bg_prio ? 1 : 0;
-                   
-               }
+                line_buffer[i + j] = color_id | pixel_info;
 
             }
          }   
@@ -457,11 +687,93 @@ static void draw_tile_bg_row(uint16_t tile_mem, uint16_t bg_mem) {
 
 
 
-      
+
+
+static inline uint64_t mix_signature(uint64_t h, uint32_t val) {
+    return (h ^ val) * 0x100000001B3ULL;
+}
+
+// Add the tile map entries of the given cells and the tiles they use to a signature
+static uint64_t cells_signature(uint64_t h, uint16_t tile_mem, uint16_t bg_mem, int cell_row, int cell_col, int count) {
+
+    for (int i = 0; i < count; i++) {
+        uint16_t addr = bg_mem + (cell_row << 5) + ((cell_col + i) & 31);
+        int tile_no = vram_read(addr, 0);
+        int tile_attributes = cgb ? vram_read(addr, 1) : 0;
+        int bank = (cgb && (booting || cgb_features)) ? !!(tile_attributes & BIT_3) : 0;
+
+        if (tile_mem == TILE_SET_1_START) {
+            tile_no = (tile_no & 127) - (tile_no & 128) + 128;
+        }
+        int tile = (bank * TILE_COUNT) + (((tile_mem - TILE_SET_0_START) >> 4) + tile_no);
+
+        h = mix_signature(h, tile_no | (tile_attributes << 16));
+        h = mix_signature(h, tile_versions[tile]);
+    }
+    return h;
+}
+
+/* Calculate a signature of all the inputs used to render the current row:
+ * registers, palettes, tile map entries and versions of the tile data
+ * used by the background, window and sprites on the row */
+static uint64_t row_signature(int render_sprites) {
+
+    refresh_gbc_bg_palettes();
+    refresh_gbc_sprite_palettes();
+
+    uint64_t h = 0xCBF29CE484222325ULL;
+    h = mix_signature(h, lcd_ctrl | (LCD_REG(SCROLL_X_REG) << 8) | (LCD_REG(SCROLL_Y_REG) << 16) | (LCD_REG(WX_REG) << 24));
+    h = mix_signature(h, LCD_REG(WY_REG) | (LCD_REG(BGP_REF) << 8) | (LCD_REG(OBP0_REG) << 16) | (LCD_REG(OBP1_REG) << 24));
+    h = mix_signature(h, palette_version);
+    h = mix_signature(h, booting);
+
+    uint16_t tile_mem = lcd_ctrl & BIT_4 ? TILE_SET_0_START : TILE_SET_1_START;
+    uint16_t bg_mem = lcd_ctrl & BIT_3 ? BG_MAP_DATA1_START : BG_MAP_DATA0_START;
+    uint8_t y_pos = row + LCD_REG(SCROLL_Y_REG);
+    h = cells_signature(h, tile_mem, bg_mem, y_pos >> 3, LCD_REG(SCROLL_X_REG) >> 3, 21);
+
+    uint8_t win_y = LCD_REG(WY_REG);
+    int win_x = LCD_REG(WX_REG) < 7 ? 0 : LCD_REG(WX_REG) - 7;
+    if ((lcd_ctrl & BIT_5) && win_y <= row && win_x <= 159) {
+        uint16_t win_bg_mem = lcd_ctrl & BIT_6 ? BG_MAP_DATA1_START : BG_MAP_DATA0_START;
+        h = cells_signature(h, tile_mem, win_bg_mem, (row - win_y) >> 3, 0, (160 - win_x + 7) >> 3);
+    }
+
+    if (render_sprites) {
+        int height = lcd_ctrl & BIT_2 ? 16 : 8;
+        int sprite_nos[10];
+        int sprite_count = get_row_sprites(sprite_nos, height);
+
+        for (int i = 0; i < sprite_count; i++) {
+            int sprite_no = sprite_nos[i];
+            uint8_t tile_no = oam[(sprite_no * 4) + 2];
+            uint8_t attributes = oam[(sprite_no * 4) + 3];
+            int bank = (cgb && (booting || cgb_features)) ? !!(attributes & BIT_3) : 0;
+            if (height == 16) {
+                tile_no &= ~0x1;
+            }
+
+            h = mix_signature(h, oam[sprite_no * 4] | (oam[(sprite_no * 4) + 1] << 8) |
+                (tile_no << 16) | (attributes << 24));
+            h = mix_signature(h, tile_versions[(bank * TILE_COUNT) + tile_no]);
+            if (height == 16) {
+                h = mix_signature(h, tile_versions[(bank * TILE_COUNT) + tile_no + 1]);
+            }
+        }
+    }
+
+    return h;
+}
+
+void get_row_skip_stats(unsigned long *rendered, unsigned long *skipped) {
+    *rendered = rows_rendered;
+    *skipped = rows_skipped;
+}
+
 
 static void draw_tile_row() {
  
-    uint8_t win_y_pos = io_mem[WY_REG];
+    uint8_t win_y_pos = LCD_REG(WY_REG);
 
     uint16_t tile_mem; // Either tile set 0 or 1
 
@@ -471,46 +783,675 @@ static void draw_tile_row() {
     refresh_gbc_bg_palettes();
     
     //Draw background    
+    int use_cache = bg_cache_enabled && !bg_cache_stale;
     uint16_t bg_mem = lcd_ctrl & BIT_3 ? BG_MAP_DATA1_START : BG_MAP_DATA0_START;
-    draw_tile_bg_row(tile_mem, bg_mem);
+    if (use_cache) {
+        draw_cached_bg_row(tile_mem, bg_mem);
+    } else {
+        draw_tile_bg_row(tile_mem, bg_mem);
+    }
 
     //Draw Window display if it's on
     if ((lcd_ctrl & BIT_5) && (win_y_pos <= row)) {
         uint16_t win_bg_mem = lcd_ctrl & BIT_6 ? BG_MAP_DATA1_START :BG_MAP_DATA0_START;
-        draw_tile_window_row(tile_mem, win_bg_mem);
+        if (use_cache) {
+            draw_cached_window_row(tile_mem, win_bg_mem);
+        } else {
+            draw_tile_window_row(tile_mem, win_bg_mem);
+        }
     }    
 }
 
 
+void set_render_policy(Render_Policy policy, unsigned frame_interval) {
+    render_policy = policy;
+    render_interval = frame_interval > 0 ? frame_interval : 1;
+    frames_until_render = 0;
+}
+
+void request_frame() {
+    frame_requested = 1;
+}
+
+// Determine from the render policy whether the next frame is rendered
+static int render_next_frame() {
+    switch (render_policy) {
+        case RENDER_EVERY_NTH_FRAME:
+            if (frames_until_render == 0) {
+                frames_until_render = render_interval - 1;
+                return 1;
+            }
+            frames_until_render--;
+            return 0;
+
+        case RENDER_ON_REQUEST: {
+            int requested = frame_requested;
+            frame_requested = 0;
+            return requested;
+        }
+
+        case RENDER_NEVER: return 0;
+        default: return 1;
+    }
+}
+
+
 void output_screen() {
+#ifdef VIDEO_CAPTURE
+    if (capturing_frame) {
+        capture_frame(frame_pixels, frame_count);
+    }
+#endif
+#ifdef RENDER_THREAD
+    // Displayed and paced by the presentation thread
+    if (present_thread_running()) {
+        publish_frame();
+        // Rows can't be rendered into the published frame
+        select_frame_buffer();
+        return;
+    }
+#endif
+#ifdef FRAME_EXPORT
+    if (frame_export.segment != NULL) {
+        uint32_t *exported = frame_pixels;
+        finish_export_frame(&frame_export);
+        // Start on the next slot straight away so the published one is never written to
+        select_frame_buffer();
+        present_frame(exported);
+        adjust_to_framerate();
+        return;
+    }
+#endif
+#ifdef VIDEO_CAPTURE
+    // Rendered into rgb_pixels rather than the screen target while capturing
+    if (capturing_frame) {
+        present_frame(frame_pixels);
+        adjust_to_framerate();
+        return;
+    }
+#endif
     draw_screen();
     adjust_to_framerate();
 }
 
+// Keep to the framerate without outputting the frame
+static void pace_skipped_frame() {
+#ifdef RENDER_THREAD
+    if (present_thread_running()) {
+        pace_frame();
+        return;
+    }
+#endif
+    adjust_to_framerate();
+}
+
+/* Invalidate anything rendered from the given VRAM page, used when
+ * the render thread moves on to a new snapshot of the page */
+static void invalidate_vram_page(int bank, int page) {
+    int start = page * VRAM_PAGE_SIZE;
+
+    if (start < BG_MAP_DATA0_START - TILE_SET_0_START) {
+        int first_tile = (bank * TILE_COUNT) + (start >> 4);
+        for (int i = 0; i < VRAM_PAGE_SIZE / 16; i++) {
+            tile_versions[first_tile + i]++;
+        }
+    } else {
+        int map = start >= BG_MAP_DATA1_START - TILE_SET_0_START;
+        memset(&bg_map_cache[map].cell_dirty[start & (MAP_CELLS - 1)], 1, VRAM_PAGE_SIZE);
+    }
+}
+
+// Render from live emulator memory, this is the default
+static void use_live_state() {
+
+    for (int bank = 0; bank < 2; bank++) {
+        uint8_t *vram = get_vram_bank(bank);
+        for (int page = 0; page < VRAM_PAGES; page++) {
+            vram_pages[bank][page] = vram + (page * VRAM_PAGE_SIZE);
+            invalidate_vram_page(bank, page);
+        }
+    }
+
+    bg_palette = get_bg_palette();
+    sprite_palette = get_sprite_palette();
+    bg_palette_changed = true;
+    sprite_palette_changed = true;
+}
+
+int set_render_thread(int enabled) {
+#ifdef RENDER_THREAD
+    render_deferred_rows();
+    if (enabled && !render_thread_running()) {
+        bg_palette = bg_palette_copy;
+        sprite_palette = sprite_palette_copy;
+        if (!start_render_thread()) {
+            use_live_state();
+            return 0;
+        }
+    } else if (!enabled && render_thread_running()) {
+        stop_render_thread();
+        use_live_state();
+    }
+    return 1;
+#else
+    return !enabled;
+#endif
+}
+
+// Forget which rows are already up to date in every buffer
+static void invalidate_row_signatures() {
+    for (int i = 0; i < EXPORT_ROWS + FRAME_EXPORT_SLOTS; i++) {
+        memset(buffer_rows[i].valid, 0, sizeof(buffer_rows[i].valid));
+    }
+}
+
+int set_present_thread(int enabled) {
+#ifdef RENDER_THREAD
+#ifdef FRAME_EXPORT
+    if (enabled && frame_export.segment != NULL) {
+        log_message(LOG_ERROR, "Frames can't be presented on a separate thread while exported\n");
+        return 0;
+    }
+#endif
+    if (enabled && !present_thread_running()) {
+        if (!start_present_thread()) {
+            return 0;
+        }
+    } else if (!enabled && present_thread_running()) {
+        stop_present_thread();
+    } else {
+        return 1;
+    }
+    // rgb_pixels has been overwritten with frames displayed by the presentation thread
+    wait_for_render_thread();
+    invalidate_row_signatures();
+    select_frame_buffer();
+    return 1;
+#else
+    return !enabled;
+#endif
+}
+
+int set_frame_export(char const *name) {
+#ifdef FRAME_EXPORT
+    if (name != NULL) {
+#ifdef RENDER_THREAD
+        if (present_thread_running()) {
+            log_message(LOG_ERROR, "Frames can't be exported while presented on a separate thread\n");
+            return 0;
+        }
+#endif
+        if (frame_export.segment != NULL) {
+            destroy_frame_export(&frame_export);
+        }
+        if (!create_frame_export(&frame_export, name)) {
+            return 0;
+        }
+    } else if (frame_export.segment != NULL) {
+        destroy_frame_export(&frame_export);
+    } else {
+        return 1;
+    }
+    // Rows rendered into the old buffers can't be reused
+#ifdef RENDER_THREAD
+    wait_for_render_thread();
+#endif
+    invalidate_row_signatures();
+    select_frame_buffer();
+    return 1;
+#else
+    return name == NULL;
+#endif
+}
+
+// Calculate the colour of every packed pixel for the current palettes
+static void update_line_colors(int cgb_mode, int rgbx) {
+
+    uint8_t bgp = LCD_REG(BGP_REF);
+    uint8_t obp[2] = {LCD_REG(OBP0_REG), LCD_REG(OBP1_REG)};
+
+    for (int i = 0; i < 0x20; i++) {
+        if (cgb_mode) {
+            line_colors[i] = rendered_bg_palette[i];
+            line_colors[PIXEL_SPRITE | i] = rendered_sprite_palette[i];
+        } else {
+            // Only palette numbers 0 (background) and 0 - 1 (sprites) are used
+            int shift = (i & 0x3) * 2;
+            int pal_no = (i >> PIXEL_PALETTE_SHIFT) & 0x1;
+            line_colors[i] = get_dmg_bg_col((bgp >> shift) & 0x3);
+            line_colors[PIXEL_SPRITE | i] = get_dmg_sprite_col((obp[pal_no] >> shift) & 0x3, pal_no);
+        }
+    }
+
+    // Swap red and blue for the screen target
+    if (rgbx) {
+        for (int i = 0; i < 0x40; i++) {
+            uint32_t c = line_colors[i];
+            line_colors[i] = (c & 0xFF00FF00) | ((c & 0xFF) << 16) | ((c >> 16) & 0xFF);
+        }
+    }
+}
+
+/* Obtain the platform's screen target
+ * returns 1 if it provides a usable target, 0 otherwise */
+static int get_valid_screen_target(Screen_Target *target) {
+    return get_screen_target(target) && target->pixels != NULL &&
+           target->scale >= 1 && target->scale <= MAX_SCALE;
+}
+
+/* Check for a new screen target from the platform,
+ * called at the start of every rendered frame */
+static void update_screen_target() {
+
+    Screen_Target target;
+    int direct = get_valid_screen_target(&target);
+#ifdef VIDEO_CAPTURE
+    // Frames are captured from rgb_pixels
+    if (capturing_frame) {
+        direct = 0;
+    }
+#endif
+
+    if (direct != direct_output || (direct && (target.pixels != screen_target.pixels ||
+        target.stride != screen_target.stride || target.scale != screen_target.scale ||
+        target.rgbx != screen_target.rgbx))) {
+        // Rows left as they were last frame won't be in the new destination
+        invalidate_row_signatures();
+        line_colors_key = UINT64_MAX;
+        target_frames = 0;
+    } else if (direct && target.refresh_interval > 0 && ++target_frames >= target.refresh_interval) {
+        // Redraw every row now and then, in case anything else draws over the screen
+        invalidate_row_signatures();
+        target_frames = 0;
+    }
+
+    direct_output = direct;
+    if (direct) {
+        screen_target = target;
+    }
+}
+
+// Render rows into the given buffer rather than the screen target
+static void use_frame_buffer(uint32_t *pixels, Row_Signatures *rows) {
+    frame_pixels = pixels;
+    row_signatures = rows;
+    if (direct_output) {
+        direct_output = 0;
+        line_colors_key = UINT64_MAX;
+    }
+}
+
+/* Choose where the rows of the next frame are rendered,
+ * called at the start of every rendered frame */
+static void select_frame_buffer() {
+    // Rows waiting to be rendered belong in the current buffer
+    render_deferred_rows();
+#ifdef VIDEO_CAPTURE
+    capturing_frame = capture_running();
+#endif
+#ifdef FRAME_EXPORT
+    if (frame_export.segment != NULL) {
+        uint32_t *pixels = begin_export_frame(&frame_export);
+        use_frame_buffer(pixels, &buffer_rows[EXPORT_ROWS + frame_export.slot]);
+        return;
+    }
+#endif
+#ifdef RENDER_THREAD
+    // The presentation thread outputs to the screen target itself
+    if (present_thread_running()) {
+        int buffer = get_back_buffer();
+        use_frame_buffer(get_present_buffer(buffer), &buffer_rows[1 + buffer]);
+        return;
+    }
+#endif
+    frame_pixels = rgb_pixels;
+    row_signatures = &buffer_rows[0];
+    update_screen_target();
+}
+
+void present_frame(uint32_t const *frame) {
+
+    Screen_Target target;
+    if (!get_valid_screen_target(&target)) {
+        if (frame != rgb_pixels) {
+            memcpy(rgb_pixels, frame, sizeof(rgb_pixels));
+        }
+        draw_screen();
+        return;
+    }
+
+    scale_pixels(frame, GB_PIXELS_X, GB_PIXELS_Y, GB_PIXELS_X, target.pixels, target.stride,
+                 target.scale, target.rgbx ? SCALE_RGBX : SCALE_BGRX);
+    draw_screen();
+}
+
+/* Write the converted row to the screen target, scaled. row_colors
+ * are already in the target's format */
+static void commit_scaled_line() {
+    uint32_t *dest = screen_target.pixels + (row * screen_target.scale * screen_target.stride);
+    scale_pixels(row_colors, GB_PIXELS_X, 1, GB_PIXELS_X, dest, screen_target.stride, screen_target.scale, SCALE_BGRX);
+}
+
+/* Convert the packed pixels of the current row from start up to end to
+ * colours, in the frame buffer or row_colors when output directly */
+static void convert_line(int start, int end) {
+
+    refresh_gbc_bg_palettes();
+    refresh_gbc_sprite_palettes();
+
+    int cgb_mode = cgb && (booting || cgb_features);
+    int rgbx = direct_output && screen_target.rgbx;
+    uint64_t key = ((uint64_t)palette_version << 32) | (rgbx << 25) | (cgb_mode << 24) |
+        (LCD_REG(BGP_REF) << 16) | (LCD_REG(OBP0_REG) << 8) | LCD_REG(OBP1_REG);
+    if (key != line_colors_key) {
+        update_line_colors(cgb_mode, rgbx);
+        line_colors_key = key;
+    }
+
+    uint32_t *out = direct_output ? row_colors : &frame_pixels[row * GB_PIXELS_X];
+    for (int x = start; x < end; x++) {
+        out[x] = line_colors[line_buffer[x] & PIXEL_COLOR_INDEX];
+    }
+}
+
+// Convert the packed pixels of the current row to colours on the screen
+static void commit_line() {
+    convert_line(0, 160);
+    if (direct_output) {
+        commit_scaled_line();
+    }
+}
+
+// Draw the background, window and sprites of the row into line_buffer
+static void draw_line_buffer() {
+
+    // Without the background in DMG mode the row is blank (colour 0)
+    if ((cgb && (cgb_features || booting)) || (lcd_ctrl & BIT_0)) {
+        draw_tile_row();
+    } else {
+        memset(line_buffer, 0, sizeof(line_buffer));
+    }
+
+    if (lcd_ctrl & BIT_1) {
+        draw_sprite_row();
+    }
+}
+
+// Render the row in the current state
+static void render_row() {
+    uint8_t render_sprites = (lcd_ctrl & BIT_1);
+
+    /* Row is entirely redrawn, if nothing it depends on has changed
+     * since the last frame it can be left as it is */
+    uint64_t signature = row_signature(render_sprites);
+    rows_rendered++;
+
+    if (row_signatures->valid[row] && row_signatures->signature[row] == signature) {
+        rows_skipped++;
+        return;
+    }
+    row_signatures->signature[row] = signature;
+    row_signatures->valid[row] = 1;
+
+    draw_line_buffer();
+    commit_line();
+}
+
+/* Render the row again in segments between the writes made to the LCD
+ * registers during mode 3, each segment with the registers as they were
+ * when it was output. Every segment draws the whole row into line_buffer
+ * and only its own pixels are kept */
+static void render_row_segments(Raster_Writes const *rw) {
+
+    uint8_t const *end_regs = lcd_regs;
+    uint8_t regs[LCD_REG_COUNT];
+    memcpy(regs, rw->start_regs, sizeof(regs));
+    lcd_regs = regs;
+
+    int start = 0;
+    for (int i = 0; i <= rw->count; i++) {
+        int end = 160;
+        if (i < rw->count) {
+            end = rw->writes[i].cycle - RASTER_START_CYCLE;
+            end = end < 0 ? 0 : end > 160 ? 160 : end;
+        }
+
+        if (end > start) {
+            lcd_ctrl = LCD_REG(LCDC_REG);
+            draw_line_buffer();
+            convert_line(start, end);
+            start = end;
+        }
+        if (i < rw->count) {
+            regs[rw->writes[i].reg] = rw->writes[i].value;
+        }
+    }
+
+    if (direct_output) {
+        commit_scaled_line();
+    }
+    lcd_regs = end_regs;
+    lcd_ctrl = LCD_REG(LCDC_REG);
+
+    // The signature only describes the row's state at the end
+    row_signatures->valid[row] = 0;
+    rows_split++;
+}
+
+// Render rows directly from emulator memory
+static void use_live_row_state() {
+
+    lcd_regs = &io_mem[LCDC_REG];
+    oam = oam_mem_ptr;
+    get_sprite_prio_order(live_sprite_order);
+    sprite_order = live_sprite_order;
+    booting = is_booting;
+
+    if (bg_palette_dirty) {
+        bg_palette_changed = true;
+        bg_palette_dirty = false;
+    }
+    if (sprite_palette_dirty) {
+        sprite_palette_changed = true;
+        sprite_palette_dirty = false;
+    }
+    lcd_ctrl = LCD_REG(LCDC_REG);
+}
+
+/* Render the given row directly from emulator memory,
+ * in segments if writes isn't NULL */
+static void render_live_row(uint8_t ly, Raster_Writes const *writes) {
+
+    use_live_row_state();
+    row = ly;
+    if (writes != NULL) {
+        render_row_segments(writes);
+    } else {
+        render_row();
+    }
+}
+
+void set_row_batching(int enabled) {
+    render_deferred_rows();
+    batch_rows = enabled;
+}
+
+void render_deferred_rows() {
+
+    if (deferred_rows == 0) {
+        return;
+    }
+
+    use_live_row_state();
+    for (int i = 0; i < deferred_rows; i++) {
+        row = deferred_row_nos[i];
+        render_row();
+    }
+    deferred_rows = 0;
+    frame_batched = 0;
+}
+
+// Render the row now, or at the end of the frame if batching rows
+static void defer_live_row(uint8_t ly) {
+    if (!batch_rows || deferred_rows == 144) {
+        render_deferred_rows();
+        render_live_row(ly, NULL);
+        frame_batched = 0;
+        return;
+    }
+    deferred_row_nos[deferred_rows++] = ly;
+}
+
+void get_batch_stats(unsigned long *frames, unsigned long *batched) {
+    *frames = frames_rendered;
+    *batched = frames_batched;
+}
+
+void render_line(Line_State const *ls) {
+
+    for (int bank = 0; bank < 2; bank++) {
+        for (int page = 0; page < VRAM_PAGES; page++) {
+            if (ls->vram_pages[bank][page] != vram_pages[bank][page]) {
+                vram_pages[bank][page] = ls->vram_pages[bank][page];
+                invalidate_vram_page(bank, page);
+            }
+        }
+    }
+
+    if (ls->palettes_dirty & LINE_BG_PALETTE_DIRTY) {
+        memcpy(bg_palette_copy, ls->bg_palette, sizeof(bg_palette_copy));
+        bg_palette_changed = true;
+    }
+    if (ls->palettes_dirty & LINE_SPRITE_PALETTE_DIRTY) {
+        memcpy(sprite_palette_copy, ls->sprite_palette, sizeof(sprite_palette_copy));
+        sprite_palette_changed = true;
+    }
+
+    lcd_regs = ls->regs;
+    oam = ls->oam;
+    sprite_order = ls->sprite_order;
+    booting = ls->is_booting;
+
+    lcd_ctrl = LCD_REG(LCDC_REG);
+    row = LCD_REG(LY_REG);
+    if (ls->raster.count > 0) {
+        render_row_segments(&ls->raster);
+    } else {
+        render_row();
+    }
+}
+
+
 //Render the row number stored in the LY register
 void draw_row() {
 
-    lcd_ctrl = io_mem[LCDC_REG];
-    row = io_mem[LY_REG];
-
-    //Render only if screen is on
-    if ((lcd_ctrl & BIT_7)) {
-        uint8_t render_sprites = (lcd_ctrl & BIT_1);
-        uint8_t render_tiles = (lcd_ctrl  & BIT_0);
+    uint8_t ly = io_mem[LY_REG];
 
-        if ((cgb && (cgb_features || is_booting)) || render_tiles) {
-            draw_tile_row();
-        
+    if (ly == 0) {
+        render_frame = render_next_frame();
+        frame_batched = 1;
+        if (render_frame) {
+#ifdef RENDER_THREAD
+            // Lines from a frame cut short by the LCD being turned off may still be queued
+            wait_for_render_thread();
+#endif
+            select_frame_buffer();
         }
-        
-        if (render_sprites) { 
-            draw_sprite_row();
+    }
+
+    //Render only if screen is on and the frame isn't being skipped
+    if (render_frame && (io_mem[LCDC_REG] & BIT_7)) {
+#ifdef RENDER_THREAD
+        if (render_thread_running()) {
+            queue_line(NULL);
+        } else {
+            defer_live_row(ly);
         }
+#else
+        defer_live_row(ly);
+#endif
    } 
 
-   if (row >= 143) {
-        output_screen();
+   if (ly >= 143) {
+        if (render_frame) {
+            frames_rendered++;
+            frames_batched += frame_batched && deferred_rows > 0;
+        }
+        render_deferred_rows();
+#ifdef RENDER_THREAD
+        // The screen and renderer state can't be touched until every line is rendered
+        wait_for_render_thread();
+#endif
+        if (render_frame) {
+            output_screen();
+        } else if (render_policy == RENDER_EVERY_NTH_FRAME) {
+            pace_skipped_frame();
+        }
         frame_drawn = 1;
+
+        // Give the background cache another chance next frame
+        frame_count++;
+        stale_cells = 0;
+        bg_cache_stale = 0;
    }  
 }
 
+int is_raster_register(uint8_t addr) {
+    return addr != STAT_REG && addr != LY_REG && addr != LYC_REG && addr != DMA_REG;
+}
+
+void raster_register_written(long cycle, uint8_t addr, uint8_t val) {
+
+    // Registers which don't change how the row looks
+    if (!is_raster_register(addr)) {
+        return;
+    }
+
+    uint8_t ly = io_mem[LY_REG];
+    if (raster_writes.count > 0 && raster_row != ly) {
+        raster_writes.count = 0; // Left over from a line cut short
+    }
+    if (raster_writes.count == 0) {
+        memcpy(raster_writes.start_regs, &io_mem[LCDC_REG], LCD_REG_COUNT);
+        raster_row = ly;
+    }
+    // Further writes are kept out of the row, it's unlikely to manage this many
+    if (raster_writes.count == MAX_RASTER_WRITES) {
+        return;
+    }
+
+    Raster_Write *w = &raster_writes.writes[raster_writes.count++];
+    w->cycle = cycle;
+    w->reg = addr - LCDC_REG;
+    w->value = val;
+}
+
+void finish_row() {
+
+    if (raster_writes.count == 0) {
+        return;
+    }
+
+    /* Row 143 has already been output with the frame, so writes during
+     * it are applied to the whole row when it's drawn */
+    uint8_t ly = io_mem[LY_REG];
+    if (render_frame && (io_mem[LCDC_REG] & BIT_7) && raster_row == ly && ly < 143) {
+#ifdef RENDER_THREAD
+        if (render_thread_running()) {
+            queue_line(&raster_writes);
+        } else {
+            render_deferred_rows();
+            render_live_row(ly, &raster_writes);
+        }
+#else
+        render_deferred_rows();
+        render_live_row(ly, &raster_writes);
+#endif
+    }
+    raster_writes.count = 0;
+}
+
+void get_raster_stats(unsigned long *rows, unsigned long *split_rows) {
+    *rows = rows_rendered;
+    *split_rows = rows_split;
+}
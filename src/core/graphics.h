@@ -1,8 +1,27 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
+#include <stdint.h>
+
 extern int frame_drawn; // Determines if a frame has been drawn
 
+/* Which frames get rendered and output to the screen, LCD timing and
+ * interrupts are unaffected. Frames which aren't rendered leave the
+ * screen buffer untouched and aren't output.
+ *
+ * RENDER_EVERY_FRAME: render all frames (default)
+ * RENDER_EVERY_NTH_FRAME: render 1 in every N frames, skipped frames
+ *                         are still paced to the framerate
+ * RENDER_ON_REQUEST: render only the frame after request_frame is called,
+ *                    skipped frames aren't paced
+ * RENDER_NEVER: never render, skipped frames aren't paced */
+typedef enum {
+    RENDER_EVERY_FRAME = 0,
+    RENDER_EVERY_NTH_FRAME = 1,
+    RENDER_ON_REQUEST = 2,
+    RENDER_NEVER = 3
+} Render_Policy;
+
 /* Initialize graphics
  * returns 1 if successful, 0 otherwise */
 int init_gfx();
@@ -10,6 +29,81 @@ int init_gfx();
 //Render the row number stored in the LY register
 void draw_row();
 
+/* Set the render policy, frame_interval is the N
+ * for RENDER_EVERY_NTH_FRAME and ignored otherwise.
+ * Takes effect from the start of the next frame */
+void set_render_policy(Render_Policy policy, unsigned frame_interval);
+
+/* Request the next frame be rendered when
+ * using RENDER_ON_REQUEST */
+void request_frame();
+
+/* Enable/Disable rendering scanlines on a separate thread from
+ * a record of each line, only available when built with RENDER_THREAD.
+ * Returns 1 if successful, 0 otherwise */
+int set_render_thread(int enabled);
+
+/* Enable/Disable displaying finished frames on a separate thread, which
+ * then also paces the emulator to the framerate. Frames finished faster
+ * than they're displayed are dropped, only available when built with
+ * RENDER_THREAD. Returns 1 if successful, 0 otherwise */
+int set_present_thread(int enabled);
+
+/* Export every rendered frame to the POSIX shared memory segment with the
+ * given name, or stop exporting if name is NULL. Only available when built
+ * with FRAME_EXPORT, not together with the presentation thread.
+ * Returns 1 if successful, 0 otherwise */
+int set_frame_export(char const *name);
+
+/* Notify the renderer that the given VRAM address in
+ * the given bank (0 or 1) has been modified */
+void vram_written(uint16_t addr, int bank);
+
+/* Notify the renderer that len bytes of VRAM starting at
+ * the given address in the given bank have been modified */
+void vram_range_written(uint16_t addr, unsigned len, int bank);
+
+/* Enable/Disable rendering the background and window from
+ * the pre-rendered background map cache (enabled by default) */
+void set_bg_cache(int enabled);
+
+/* Obtain the number of rows rendered and how many of those
+ * were skipped as unchanged since the previous frame */
+void get_row_skip_stats(unsigned long *rendered, unsigned long *skipped);
+
+/* Returns 1 if the LCD register at addr (LCDC - WX) changes how rows
+ * look, 0 for STAT, LY, LYC and DMA */
+int is_raster_register(uint8_t addr);
+
+/* Record a write of val to the LCD register at addr (LCDC - WX) made the
+ * given number of cycles into mode 3 of the row in LY, called before the
+ * write is applied */
+void raster_register_written(long cycle, uint8_t addr, uint8_t val);
+
+/* Called at the end of mode 3, if the LCD registers were written to during
+ * it the row is rendered again in segments between the writes */
+void finish_row();
+
+/* Obtain the number of rows rendered and how many of
+ * those had to be rendered in segments */
+void get_raster_stats(unsigned long *rows, unsigned long *split_rows);
+
+/* Enable/Disable rendering all rows together at the end of the frame
+ * (enabled by default). Rows are only rendered earlier when something
+ * they're rendered from is about to be modified */
+void set_row_batching(int enabled);
+
+extern int deferred_rows; // Rows waiting to be rendered
+
+/* Render the rows waiting to be rendered, must be called before the LCD
+ * registers, palettes, VRAM or OAM are modified while deferred_rows is
+ * non zero */
+void render_deferred_rows();
+
+/* Obtain the number of frames rendered and how many of
+ * those had every row rendered together at the end */
+void get_batch_stats(unsigned long *frames, unsigned long *batched);
+
 void output_screen();
 
 
@@ -13,7 +13,6 @@
 #define JOYPAD_ISR_ADDR  0x60
 
 #define TOTAL_INTERRUPTS (JOYPAD_INT + 1)
-#define INTERRUPTS_LEN sizeof (interrupts) / sizeof (interrupts[0])
 
 /* For each interrupt this contains their bit no in the Interrupt Flag,
  * as well as the address in memory of their interrupt service
@@ -31,12 +30,25 @@ static const struct {
 };
 
 
+/* Index into interrupts[] of the highest priority interrupt
+ * for each combination of the 4 interrupt bits checked */
+static const uint8_t lowest_interrupt[16] = {0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0};
+
+int interrupt_pending = 0;
+
+
+void update_interrupt_pending() {
+    interrupt_pending = (io_mem[INTERRUPT_REG] & io_mem[INTERRUPT_ENABLE_REG] & 0xF) != 0;
+}
+
+
 /* Given an interrupt code, raises the interrupt.
  * does nothing if interrupt code supplied is invalid */
 void raise_interrupt(InterruptCode ic) {
     
     if (ic < TOTAL_INTERRUPTS) { // Set flag for interrupt
         io_mem[INTERRUPT_REG] |= BIT(ic);
+        update_interrupt_pending();
     } 
 }
 
@@ -52,34 +64,30 @@ int handle_interrupts() {
 
     if (possible_interrupts != 0) {
         
-        // Go through each interrupt and check if it has been raised
-        for (unsigned long i = 0; i < INTERRUPTS_LEN; i++) {
-           
-            uint8_t flag = interrupts[i].flag;
-            if ((flag & possible_interrupts) != 0) {
-                //Still need to check if master override is not in place 
-                if (master_interrupts_enabled()) {
-                    /* Unset interrupt flag for interrupt being serviced
-                     * unset master interrupts so interrupt handler routine
-                     * isn't unecessarily interrupted and then call
-                     * the interrupt handler */
-                    io_mem[INTERRUPT_REG] = if_flags & ~flag;
-                    master_interrupts_disable(); 
-                    restart(interrupts[i].isr_addr);
-
-                    halted = 0;
-                    return 0;
-                }
-                /* If Gameboy, SGB or Gameboy pocket PC is halted
-                 * and interrupts disabled, cpu is unhalted and
-                 * bug in the original system causes the next
-                 * 1st byte of instruction to be repeated */
-                else if (halted) {
-                    halted = 0;
-                    if (!cgb) {
-                        return 1;
-                    }
-                }
+        // Only the highest priority interrupt raised is serviced
+        int i = lowest_interrupt[possible_interrupts];
+        //Still need to check if master override is not in place 
+        if (master_interrupts_enabled()) {
+            /* Unset interrupt flag for interrupt being serviced
+             * unset master interrupts so interrupt handler routine
+             * isn't unecessarily interrupted and then call
+             * the interrupt handler */
+            io_mem[INTERRUPT_REG] = if_flags & ~interrupts[i].flag;
+            update_interrupt_pending();
+            master_interrupts_disable(); 
+            restart(interrupts[i].isr_addr);
+
+            halted = 0;
+            return 0;
+        }
+        /* If Gameboy, SGB or Gameboy pocket PC is halted
+         * and interrupts disabled, cpu is unhalted and
+         * bug in the original system causes the next
+         * 1st byte of instruction to be repeated */
+        else if (halted) {
+            halted = 0;
+            if (!cgb) {
+                return 1;
             }
         }
     }
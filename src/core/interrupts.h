@@ -3,6 +3,14 @@
 
 typedef enum { VBLANK_INT = 0, LCD_INT = 1, TIMER_INT = 2, IO_INT = 3, JOYPAD_INT = 4 } InterruptCode;
 
+/* Set when an interrupt is both raised and enabled, handle_interrupts
+ * has nothing to do while it isn't */
+extern int interrupt_pending;
+
+/* Recalculate interrupt_pending, must be called after
+ * the IF or IE register is changed */
+void update_interrupt_pending();
+
 /* Given an interrupt code, raises the interrupt.
  * does nothing if interrupt code supplied is invalid */
 void raise_interrupt(InterruptCode ic);
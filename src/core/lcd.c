@@ -11,6 +11,7 @@
 
 
 #define MAX_SL_CYCLES 456
+#define NO_LCD_EVENT 0x7FFFFFFF
 
 static long current_cycles = 0;
 static long current_aux_cycles = 0;
@@ -23,6 +24,11 @@ static uint8_t hide_frames = 0;
 static uint8_t window_line = 0;
 static uint8_t vblank_line = 0;
 static uint8_t scanline_transferred = 0;
+/* Nothing happens until current_cycles reaches next_event_cycles, the
+ * cycles until then are added up in pending_cycles. 0 if the state was
+ * changed from outside and the next event needs working out again */
+static long next_event_cycles = 0;
+static long pending_cycles = 0;
 
 int screen_enabled() {
     return !screen_off;
@@ -38,6 +44,8 @@ void reset_window_line() {
 void enable_screen() {
     if (screen_off) {
         screen_enable_delay_cycles = 244;
+        next_event_cycles = 0;
+        pending_cycles = 0;
     }
 }
 
@@ -52,6 +60,8 @@ void disable_screen() {
     current_aux_cycles = 0;
     ly_counter = 0;
     stat_interrupt_signal = 0;
+    next_event_cycles = 0;
+    pending_cycles = 0;
 }
 
 uint8_t get_interrupt_signal() {
@@ -74,10 +84,31 @@ int lcd_hblank_mode() {
     return current_lcd_mode == 0;
 }
 
+void lcd_register_written(uint8_t addr, uint8_t val) {
+    if (current_lcd_mode == 3 && !screen_off) {
+        raster_register_written(current_cycles, addr, val);
+    }
+}
+
 static void update_stat() {
     io_mem[STAT_REG] = (io_mem[STAT_REG] & 0xFC) | (current_lcd_mode & 0x3); 
 }
 
+void lcd_set_vblank(long cycles) {
+    screen_off = 0;
+    screen_enable_delay_cycles = 0;
+    current_lcd_mode = 1;
+    current_cycles = cycles;
+    vblank_line = cycles < 4104 ? cycles / 456 : 9;
+    current_aux_cycles = cycles - (vblank_line * 456);
+    // LY is reset to 0 early in the last line
+    ly_counter = (vblank_line == 9 && current_aux_cycles >= 4) ? 0 : 144 + vblank_line;
+    io_mem[LY_REG] = ly_counter;
+    update_stat();
+    next_event_cycles = 0;
+    pending_cycles = 0;
+}
+
 /* Given lcd_stat returns the new lcd_stat with the coincidence bit
  * set if there is a coincidence, unset if there isn't. Also
  * if there is a coincidence and coincidence flag is set
@@ -108,10 +139,48 @@ void check_lcd_coincidence() {
 
 
 
+// Work out the value of current_cycles at which the next event happens
+static long next_lcd_event() {
+
+    if (screen_off) {
+        return screen_enable_delay_cycles > 0 ?
+            current_cycles + screen_enable_delay_cycles : NO_LCD_EVENT;
+    }
+
+    switch (current_lcd_mode) {
+        case 0: return 204;
+        case 2: return 80;
+        case 3:
+            if (!scanline_transferred) {
+                return ly_counter == 0 ? 160 : 48;
+            }
+            return 172;
+
+        default: {
+            // Next line, LY reset after 153 or the end of V-Blank
+            long next = current_cycles + (456 - current_aux_cycles);
+            if (ly_counter == 153) {
+                long reset = current_cycles + (4 - current_aux_cycles);
+                reset = reset < 4104 ? 4104 : reset;
+                next = reset < next ? reset : next;
+            }
+            return next < 4560 ? next : 4560;
+        }
+    }
+}
+
 /* Update the LCD with given number of clock cycles */
 static long update_lcd(long cycles) {
       
     current_cycles += cycles;
+    pending_cycles += cycles;
+    if (current_cycles < next_event_cycles) {
+        return cycles;
+    }
+    // Cycles since the LCD was last updated
+    long elapsed = pending_cycles;
+    pending_cycles = 0;
+
     //int vblank = 0;
     if (!screen_off) {
 
@@ -181,7 +250,7 @@ static long update_lcd(long cycles) {
 
         case 1 : // V-Blank
                 
-                current_aux_cycles += cycles;
+                current_aux_cycles += elapsed;
                 if (current_aux_cycles >= 456) {
                     current_aux_cycles -= 456;
                     vblank_line++;
@@ -236,6 +305,7 @@ static long update_lcd(long cycles) {
                 }                
 
                 if (current_cycles >= 172) {
+                    finish_row();
                     current_cycles -= 172;
                     current_lcd_mode = 0;
                     update_stat();
@@ -256,7 +326,7 @@ static long update_lcd(long cycles) {
     // Screen off
     } else {
         if (screen_enable_delay_cycles > 0) {
-            screen_enable_delay_cycles -= cycles;
+            screen_enable_delay_cycles -= elapsed;
 
             if (screen_enable_delay_cycles <= 0) {
                 screen_enable_delay_cycles = 0;
@@ -282,6 +352,7 @@ static long update_lcd(long cycles) {
         }    
     }
 
+    next_event_cycles = next_lcd_event();
     return cycles;
 }
 
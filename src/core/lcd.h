@@ -23,6 +23,10 @@ void enable_screen();
 
 void disable_screen();
 
+/* Turn the screen on part way through V-Blank,
+ * given the number of cycles into it (0 - 4559) */
+void lcd_set_vblank(long cycles);
+
 uint8_t get_interrupt_signal();
 
 int get_lcd_mode();
@@ -37,4 +41,9 @@ int lcd_vblank_mode();
 
 int lcd_hblank_mode();
 
+/* Called before val is written to the LCD register at addr (LCDC - WX),
+ * so writes while the row is transferred to the LCD can be rendered
+ * part way along it */
+void lcd_register_written(uint8_t addr, uint8_t val);
+
 #endif //LCD_H
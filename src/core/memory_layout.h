@@ -84,7 +84,7 @@
 #define NR_10_REG 0x10 /*  Sweep */
 #define NR_11_REG 0x11 /*  Length wave pattern*/
 #define NR_12_REG 0x12 /*  Envelope */
-#define NR_13_REG 0x12 /*  Frequency Lo */
+#define NR_13_REG 0x13 /*  Frequency Lo */
 #define NR_14_REG 0x14 /*  Frequency Hi */
 
 /*   Sound Mode 2 registers */
@@ -51,9 +51,7 @@ long perform_hdma() {
     uint16_t source = hdma_source;
     uint16_t dest = hdma_dest | 0x8000;
 
-    for (int i = 0; i < 0x10; i++) {
-        set_mem(dest + i, get_mem(source + i));       
-    }
+    copy_to_vram(dest, source, 0x10);
 
     hdma_source += 0x10;
     hdma_dest +=  0x10;
@@ -89,9 +87,7 @@ void perform_gdma(uint8_t value) {
     uint16_t source = hdma_source & 0xFFF0;
     uint16_t dest = (hdma_dest & 0x1FF0) | 0x8000;
  
-    for (int i = 0; i < hdma_bytes; i++) {
-        set_mem(dest + i, get_mem(source + i));       
-    }
+    copy_to_vram(dest, source, hdma_bytes);
 
     memset(io_mem + HDMA1_REG, 0xFF, HDMA5_REG - HDMA1_REG + 1);
 
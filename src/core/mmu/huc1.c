@@ -45,6 +45,20 @@ uint8_t read_HUC1(uint16_t addr) {
     return 0x0;
 }
 
+uint8_t const *bank_ptr_HUC1(uint16_t addr, unsigned *len) {
+
+    if (addr < 0x4000) {
+        *len = 0x4000 - addr;
+        return &ROM_banks[addr];
+    }
+    if (addr < 0x8000) {
+        *len = 0x8000 - addr;
+        return &ROM_banks[(cur_ROM_bank * ROM_BANK_SIZE) | (addr & 0x3FFF)];
+    }
+    *len = 0xC000 - addr;
+    return &RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr & 0x1FFF)];
+}
+
 
 void write_HUC1(uint16_t addr, uint8_t val) {
     
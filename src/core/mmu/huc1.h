@@ -5,5 +5,6 @@
 void setup_HUC1(int flags);
 uint8_t read_HUC1(uint16_t addr);
 void   write_HUC1(uint16_t addr, uint8_t val);
+uint8_t const *bank_ptr_HUC1(uint16_t addr, unsigned *len);
 
 #endif //HUC1_H
@@ -19,6 +19,7 @@ static int cur_RAM_bank = 0; // Current ROM bank 0x0 - 0x7F
 static int cur_ROM_bank = 1; // Current RAM bank 0x0 - 0x0F
 static int ram_banking = 0;  // 0: RAM banking off, 1: RAM banking on
 static int battery = 0;
+static int sram_modified = 0;
 static int huc3_ramflag = 0;
 static int huc3_value = 0;
 static uint64_t clock_register = 0;
@@ -26,37 +27,66 @@ static uint64_t clock_shift = 0;
 static uint64_t clock_time = 0;
 
 
+#define MINUTE_SECONDS 60
+#define DAY_SECONDS (24 * 60 * 60)
+#define YEAR_SECONDS (365 * DAY_SECONDS)
+
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = v >> (i * 8);
+    }
+}
+
+static uint32_t get_u32(uint8_t const *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Clock state saved after the RAM banks: the clock register and the
+ * host time in seconds it was last brought up to date at */
+static void save_clock() {
+    put_u32(RTC_save, clock_register);
+    put_u32(RTC_save + 4, clock_time);
+    put_u32(RTC_save + 8, clock_time >> 32);
+}
+
+static void load_clock() {
+    clock_register = get_u32(RTC_save);
+    clock_time = get_u32(RTC_save + 4) | ((uint64_t)get_u32(RTC_save + 8) << 32);
+    if (clock_time == 0) { // No clock saved
+        clock_time = get_time() / 1000;
+    }
+}
+
+
 void setup_HUC3(int flags) {
     battery = (flags & BATTERY) ? 1 : 0;
     // Check for previous saves if Battery active
     if (battery) {
         read_SRAM();
     }
+    load_clock();
 }
 
 
 
+/* Add the time passed since the clock was last updated, so the
+ * clock only needs to be brought up to date when read */
 void update_clock() {
-	uint64_t now = 0; // get_time();
-    uint64_t elapsed = now - clock_time;
+	uint64_t now = get_time() / 1000;
+    uint64_t elapsed = now > clock_time ? now - clock_time : 0;
 	
 	// Get Years 4 bits
-	while (elapsed >= 365 * 24 * 60 * 60) {
-		clock_register += (1 << 24);
-		elapsed -= 365 * 24 * 60 * 60;
-	}	
+	clock_register += (elapsed / YEAR_SECONDS) << 24;
+	elapsed %= YEAR_SECONDS;
 
 	// Get Days 12 bits
-	while (elapsed >= 24 * 60 * 60) {
-		clock_register += (1 << 12);
-		elapsed -= 24 * 60 * 60;
-	}
+	clock_register += (elapsed / DAY_SECONDS) << 12;
+	elapsed %= DAY_SECONDS;
 
 	// Minutes 12 bits
-	while (elapsed >= 60) {
-		clock_register += 1;
-		elapsed -= 60;
-	}
+	clock_register += elapsed / MINUTE_SECONDS;
+	elapsed %= MINUTE_SECONDS;
 
 	if ((clock_register & 0x0000FFF) >= 24 * 60) {
 		clock_register += (1 << 12) - 24 * 60;
@@ -67,6 +97,7 @@ void update_clock() {
 	}
 
 	clock_time = now - elapsed;
+	save_clock();
 }
 	
 
@@ -107,12 +138,35 @@ uint8_t read_HUC3(uint16_t addr) {
     return 0xFF;
 }
 
+uint8_t const *bank_ptr_HUC3(uint16_t addr, unsigned *len) {
+
+    if (addr < 0x4000) {
+        *len = 0x4000 - addr;
+        return &ROM_banks[addr];
+    }
+    if (addr < 0x8000) {
+        *len = 0x8000 - addr;
+        return &ROM_banks[(cur_ROM_bank * ROM_BANK_SIZE) | (addr & 0x3FFF)];
+    }
+    // Other modes read the clock and IR registers
+    if ((huc3_ramflag == 0x0 || huc3_ramflag == 0xA) && ram_banking) {
+        *len = 0xC000 - addr;
+        return &RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr & 0x1FFF)];
+    }
+    return NULL;
+}
+
 
 void write_HUC3(uint16_t addr, uint8_t val) {
     
     switch (addr & 0xF000) {
         case 0x0000:
         case 0x1000: 
+                    // Leaving RAM and clock modes, save SRAM and the clock to file
+                    if (battery && sram_modified && val != 0xA && val != 0xB) {
+                        write_SRAM();
+                        sram_modified = 0;
+                    }
 					ram_banking = val & 0x0A;
                     huc3_ramflag = val;
                     break;
@@ -145,6 +199,8 @@ void write_HUC3(uint16_t addr, uint8_t val) {
 										clock_register &= ~(0x0F << clock_shift);
 										clock_register |= ((val & 0xF) << clock_shift);
 										clock_shift += 4;
+										save_clock();
+										sram_modified = 1;
 									}
 									break;
 
@@ -165,7 +221,8 @@ void write_HUC3(uint16_t addr, uint8_t val) {
 									break;	
 						}	
 					} else if (huc3_ramflag == 0x0A && ram_banking) {
-							RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr & 0x1FFF)] = val;					
+							RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr & 0x1FFF)] = val;
+							sram_modified = 1;
 					} 
                     break;
     }    
@@ -5,5 +5,6 @@
 void setup_HUC3(int flags);
 uint8_t read_HUC3(uint16_t addr);
 void   write_HUC3(uint16_t addr, uint8_t val);
+uint8_t const *bank_ptr_HUC3(uint16_t addr, unsigned *len);
 
 #endif //HUC3_H
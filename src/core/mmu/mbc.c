@@ -28,55 +28,33 @@ uint8_t *ROM_banks; // max 512 * 16KB rom banks (8MB) 0x4000
 
 read_MBC_ptr read_MBC = NULL;
 write_MBC_ptr write_MBC = NULL; 
+bank_ptr_MBC_ptr bank_ptr_MBC = NULL;
 
 #define MAX_SRAM_FNAME_SIZE 256
 
 static char SRAM_filename[MAX_SRAM_FNAME_SIZE + 1];
 unsigned RAM_bank_count = 0;
-static int mbc3_rtc = 0;
+uint8_t *RTC_save = NULL;
+// RAM banks and the clock state if the cartridge has one
+static unsigned long SRAM_size = 0;
 
 void write_SRAM() {
-    save_SRAM(SRAM_filename, RAM_banks, RAM_bank_count * 0x2000);
+    save_SRAM(SRAM_filename, RAM_banks, SRAM_size);
 }
 
 
 void read_SRAM() {
 
     size_t len;
-    if((len = load_SRAM(SRAM_filename, RAM_banks, RAM_bank_count * 0x2000))) {
-        if (len !=( RAM_bank_count * 0x2000)) { // Not enough read in
+    if((len = load_SRAM(SRAM_filename, RAM_banks, SRAM_size))) {
+        // Saves without the clock state only contain the RAM banks
+        if (len != SRAM_size && len != (RAM_bank_count * 0x2000)) { // Not enough read in
             memset(RAM_banks, 0, len); //"Erase" what just got read into memory
         }
     }
 }
 
 
-
-void inc_sec_mbc3() {
-	if (mbc3_rtc) {
-		inc_rtc_second();
-	}
-}
-
-//TODO
-rtc_regs_MBC3 read_RTC() {
-  	rtc_regs_MBC3 r;
-
-	r.seconds = 0x0;
-	r.minutes = 0x0;
-	r.hours = 0x0;
-	r.days_low = 0x0;
-	r.flags = 0x0;
-	
-	return r;	
-}
-
-//TODO
-void write_RTC(rtc_regs_MBC3 rtc_regs){
-	return;
-}
-
-
 static void create_SRAM_filename(const char *filename) {
 
     memset(SRAM_filename, 0, MAX_SRAM_FNAME_SIZE);
@@ -101,35 +79,36 @@ void teardown_MBC() {
    free(ROM_banks); 
 }
 
-int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *filename) {
+int setup_MBC(int MBC_no, unsigned ram_banks, uint8_t *rom, const char *filename) {
 
     create_SRAM_filename(filename);
     RAM_bank_count = ram_banks;
 
+    // MBC3 with a timer and HuC3 save their clocks after the RAM banks
+    int has_clock = MBC_no == 0xF || MBC_no == 0x10 || MBC_no == 0xFE;
+    SRAM_size = (ram_banks * RAM_BANK_SIZE) + (has_clock ? RTC_SAVE_SIZE : 0);
+
 	RAM_banks = NULL;
-	if (RAM_bank_count > 0) {
-    	RAM_banks = malloc(ram_banks * RAM_BANK_SIZE);
+	RTC_save = NULL;
+	if (SRAM_size > 0) {
+    	RAM_banks = malloc(SRAM_size);
     	if (RAM_banks == NULL) {
         	log_message(LOG_ERROR, "Unable to allocate memory for RAM banks\n");
         	return 0;
     	}
+    	if (has_clock) {
+    	    RTC_save = RAM_banks + (ram_banks * RAM_BANK_SIZE);
+    	    memset(RTC_save, 0, RTC_SAVE_SIZE);
+    	}
 	}
 
-    ROM_banks = malloc(rom_banks * ROM_BANK_SIZE);
-    if (ROM_banks == NULL) {
-        log_message(LOG_ERROR, "Unable to allocate memory for ROM banks\n");
-        if (RAM_banks != NULL) {
-			free(RAM_banks);
-		}
-        return 0;
-    }
-
     int flags = 0;
     // MMBC0
     if (MBC_no == 0) {
 
         read_MBC = &read_MBC0;
         write_MBC = &write_MBC0;  
+        bank_ptr_MBC = &bank_ptr_MBC0;
 
    // MBC1
    } else if(MBC_no >= 1 && MBC_no <= 3) {
@@ -142,6 +121,7 @@ int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *fi
         setup_MBC1(flags);
         read_MBC = &read_MBC1;
         write_MBC = &write_MBC1;
+        bank_ptr_MBC = &bank_ptr_MBC1;
 
    // MBC2
    } else if (MBC_no >= 5 && MBC_no <= 6) {
@@ -152,6 +132,7 @@ int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *fi
 		setup_MBC2(flags);
 		read_MBC = &read_MBC2;
 		write_MBC = &write_MBC2;
+		bank_ptr_MBC = &bank_ptr_MBC2;
 
    // MMM01
    } else if(MBC_no >= 0xB && MBC_no <= 0xD) {
@@ -165,13 +146,14 @@ int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *fi
         setup_MMM01(flags);
         read_MBC =&read_MMM01;
         write_MBC = &write_MMM01; 
+        bank_ptr_MBC = &bank_ptr_MMM01;
 
    // MBC3
    } else if(MBC_no >= 0xF && MBC_no <= 0x13) {
    
         switch (MBC_no) {
-            case 0xF : flags = RTC | BATTERY; mbc3_rtc = 1; break;
-            case 0x10: flags = RTC | BATTERY | SRAM; mbc3_rtc = 1; break;
+            case 0xF : flags = RTC | BATTERY; break;
+            case 0x10: flags = RTC | BATTERY | SRAM; break;
             case 0x11: flags = 0; break;
             case 0x12: flags = SRAM; break;
             case 0x13: flags = BATTERY | SRAM; break;
@@ -180,6 +162,7 @@ int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *fi
         setup_MBC3(flags);
         read_MBC = &read_MBC3;
         write_MBC = &write_MBC3;
+        bank_ptr_MBC = &bank_ptr_MBC3;
     
    // MBC5 
    } else if (MBC_no >= 0x19 && MBC_no <= 0x1E) {
@@ -196,6 +179,7 @@ int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *fi
         setup_MBC5(flags);
         read_MBC = &read_MBC5;
         write_MBC = &write_MBC5;
+        bank_ptr_MBC = &bank_ptr_MBC5;
    }
   
    // HUC3
@@ -204,6 +188,7 @@ int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *fi
        setup_HUC3(flags);
        read_MBC = &read_HUC3;
        write_MBC = &write_HUC3;
+       bank_ptr_MBC = &bank_ptr_HUC3;
    } 
    
    // HUC1
@@ -212,12 +197,18 @@ int setup_MBC(int MBC_no, unsigned ram_banks, unsigned rom_banks, const char *fi
         setup_HUC1(flags);
         read_MBC = &read_HUC1;
         write_MBC = &write_HUC1;
+        bank_ptr_MBC = &bank_ptr_HUC1;
    }
     
    else{ 
        log_message(LOG_ERROR, "unimplimented MBC mode for code %d\n",MBC_no);
+       free(RAM_banks);
+       RAM_banks = NULL;
+       RTC_save = NULL;
        return 0;
    }
 
+   // Only take the ROM once the cartridge type is supported
+   ROM_banks = rom;
    return 1;
 }
@@ -11,6 +11,11 @@ extern uint8_t *ROM_banks;//[][0x4000];// max 512 * 16KB rom banks (8MB) 0x4000
 
 extern unsigned RAM_bank_count;
 
+/* Cartridges with a clock save its state in the RTC_SAVE_SIZE
+ * bytes following the RAM banks, NULL otherwise */
+#define RTC_SAVE_SIZE 48
+extern uint8_t *RTC_save;
+
 typedef enum {SRAM = 0x1, BATTERY = 0x2, RTC = 0x4, RUMBLE = 0x8, ACCELEROMETER = 0x10} features;
 
 // Real time clock registers for MBC3
@@ -28,9 +33,11 @@ typedef struct {
 
 
 /*  Setup a memory bank controller for the given
- *  cartridge type id. Returns 1 if successful,
+ *  cartridge type id, using the ROM already loaded
+ *  (taken only if successful, then freed by teardown_MBC).
+ *  Returns 1 if successful,
  *  0 if not implemented or invalid. */
-int setup_MBC(int no, unsigned ram_banks, unsigned rom_banks, char const *file_name);
+int setup_MBC(int no, unsigned ram_banks, uint8_t *rom, char const *file_name);
 
 
 // Frees RAM/ROM banks
@@ -38,21 +45,11 @@ void teardown_MBC();
 
 
 /* Writes/Reads ROM SRAM from file, used for
- * save games */
+ * save games. Includes RTC_save if the cartridge has a clock */
 void write_SRAM();
 void read_SRAM();
 
 
-//Increments the RTC clock in MBC3
-void inc_sec_mbc3();
-
-/* Writes/Reads RTC data from file,
-   used to emulate MBC3 cartridge clock battery
-   while the game is turned off */
-rtc_regs_MBC3 read_RTC();
-void write_RTC(rtc_regs_MBC3 rtc_regs);
-
-
 /*  Placeholders for write/read function ptrs
  *  depending on MBC mode */
 typedef uint8_t (*read_MBC_ptr)(uint16_t addr);
@@ -61,5 +58,13 @@ typedef void   (*write_MBC_ptr)(uint16_t addr, uint8_t val);
 extern read_MBC_ptr read_MBC;
 extern write_MBC_ptr write_MBC; 
 
+/*  Given an address in 0x0000 - 0x7FFF or 0xA000 - 0xBFFF, returns
+ *  the memory of the bank currently mapped there, with the number of
+ *  bytes mapped in a row from it in len. NULL if reads there don't
+ *  come from memory (RAM disabled, clock registers etc.) */
+typedef uint8_t const *(*bank_ptr_MBC_ptr)(uint16_t addr, unsigned *len);
+
+extern bank_ptr_MBC_ptr bank_ptr_MBC;
+
 
 #endif //MBC_H
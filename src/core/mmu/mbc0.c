@@ -19,6 +19,15 @@ uint8_t read_MBC0(uint16_t addr) {
     return 0x0;
 }
 
+uint8_t const *bank_ptr_MBC0(uint16_t addr, unsigned *len) {
+
+    if (addr < 0x8000) {
+        *len = 0x8000 - addr;
+        return &ROM_banks[addr];
+    }
+    return NULL;
+}
+
 
 void write_MBC0(uint16_t addr, uint8_t val) {
     return;
@@ -4,6 +4,7 @@
 
 uint8_t read_MBC0(uint16_t addr);
 void   write_MBC0(uint16_t addr, uint8_t val);
+uint8_t const *bank_ptr_MBC0(uint16_t addr, unsigned *len);
 
 
 #endif
@@ -61,6 +61,27 @@ uint8_t read_MBC1(uint16_t addr) {
     return 0x0;
 }
 
+uint8_t const *bank_ptr_MBC1(uint16_t addr, unsigned *len) {
+
+    if (addr < 0x4000) {
+        *len = 0x4000 - addr;
+        return &ROM_banks[addr];
+    }
+    if (addr < 0x8000) {
+        *len = 0x8000 - addr;
+        return bank_mode == 0 ?
+            &ROM_banks[((cur_RAM_bank << 5 | cur_ROM_bank) * ROM_BANK_SIZE) | (addr - 0x4000)] :
+            &ROM_banks[(cur_ROM_bank * ROM_BANK_SIZE) | (addr - 0x4000)];
+    }
+    if (ram_banking) {
+        *len = 0xC000 - addr;
+        return bank_mode == 0 ?
+            &RAM_banks[addr - 0xA000] :
+            &RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000)];
+    }
+    return NULL;
+}
+
 
 void write_MBC1(uint16_t addr, uint8_t val) {
     
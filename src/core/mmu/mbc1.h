@@ -6,6 +6,7 @@ void setup_MBC1(int flags);
 
 uint8_t read_MBC1(uint16_t addr);
 void   write_MBC1(uint16_t addr, uint8_t val);
+uint8_t const *bank_ptr_MBC1(uint16_t addr, unsigned *len);
 
 
 #endif
@@ -51,6 +51,24 @@ uint8_t read_MBC2(uint16_t addr) {
     return 0x0;
 }
 
+uint8_t const *bank_ptr_MBC2(uint16_t addr, unsigned *len) {
+
+    if (addr < 0x4000) {
+        *len = 0x4000 - addr;
+        return &ROM_banks[addr];
+    }
+    if (addr < 0x8000) {
+        *len = 0x8000 - addr;
+        return &ROM_banks[(cur_ROM_bank * ROM_BANK_SIZE) | (addr & 0x3FFF)];
+    }
+    // The 512 bytes of RAM repeat through 0xA000 - 0xAFFF
+    if (addr < 0xB000 && ram_banking) {
+        *len = 0x200 - (addr & 0x1FF);
+        return &RAM_banks[addr & 0x1FF];
+    }
+    return NULL;
+}
+
 
 void write_MBC2(uint16_t addr, uint8_t val) {
     
@@ -2,8 +2,7 @@
 #include "mbc3.h"
 #include "memory.h"
 #include "../bits.h"
-
-#include  <time.h>
+#include "../../non_core/get_time.h"
 
 static int cur_RAM_bank = 0;
 static int cur_ROM_bank = 1;
@@ -14,35 +13,127 @@ static int battery = 0;
 static int rtc_enabled = 0;
 static int sram_modified = 0;
 
-static rtc_regs_MBC3 rtc_regs, latch_regs;
+static rtc_regs_MBC3 latch_regs;
+
+/* The clock isn't counted while running, it's kept as the host time
+ * in seconds it last read 0 and only worked out when latched, written
+ * to or saved */
+static int64_t rtc_start = 0;
+static int64_t rtc_halted_value = 0; // Seconds on the clock while halted
+static uint8_t rtc_flags = 0; // Halt and day carry bits
+
+#define RTC_DAY_SECONDS (24 * 60 * 60)
+#define RTC_MAX_SECONDS (512 * RTC_DAY_SECONDS) // 9 bit day counter
+
+
+static int64_t host_seconds() {
+    return get_time() / 1000;
+}
 
+// Seconds on the clock at the given host time
+static int64_t rtc_value(int64_t now) {
 
-void inc_rtc_second() {
-  if ((rtc_regs.flags & BIT_6) == 0) {
+    int64_t value = (rtc_flags & BIT_6) ? rtc_halted_value : now - rtc_start;
+    if (value >= 0 && value < RTC_MAX_SECONDS) {
+        return value;
+    }
 
-  	if(++rtc_regs.seconds >= 60) {
-      rtc_regs.seconds = 0;
+    // Day counter overflowed, or the host clock went backwards
+    if (value >= RTC_MAX_SECONDS) {
+        rtc_flags |= BIT_7;
+        value %= RTC_MAX_SECONDS;
+    } else {
+        value = 0;
+    }
 
-      if(++rtc_regs.minutes >= 60) {
-        rtc_regs.minutes = 0;
+    if (rtc_flags & BIT_6) {
+        rtc_halted_value = value;
+    } else {
+        rtc_start = now - value;
+    }
+    return value;
+}
+
+static rtc_regs_MBC3 get_rtc_regs(int64_t now) {
+
+    int64_t value = rtc_value(now);
+    int days = value / RTC_DAY_SECONDS;
+
+    rtc_regs_MBC3 r;
+    r.seconds = value % 60;
+    r.minutes = (value / 60) % 60;
+    r.hours = (value / (60 * 60)) % 24;
+    r.days_low = days & 0xFF;
+    r.flags = (rtc_flags & (BIT_6 | BIT_7)) | (days >> 8);
+    return r;
+}
+
+static void set_rtc_regs(rtc_regs_MBC3 r, int64_t now) {
+
+    int64_t value = r.seconds + (r.minutes * 60) + (r.hours * 60 * 60) +
+                    ((int64_t)(r.days_low | ((r.flags & BIT_0) << 8)) * RTC_DAY_SECONDS);
+
+    rtc_flags = r.flags & (BIT_6 | BIT_7);
+    if (rtc_flags & BIT_6) {
+        rtc_halted_value = value;
+    } else {
+        rtc_start = now - value;
+    }
+}
 
-        if(++rtc_regs.hours >= 24) {
-          rtc_regs.hours = 0;
 
-		  if (++rtc_regs.days_low == 0) {
-		  	if (rtc_regs.flags & 0x1) {
-				rtc_regs.flags |= 0x7;
-			} else {
-				rtc_regs.flags |= 0x1;
-			}	
-          }
-        }
-      }
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = v >> (i * 8);
     }
-  }
 }
 
+static uint32_t get_u32(uint8_t const *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_regs(uint8_t *p, rtc_regs_MBC3 r) {
+    put_u32(p, r.seconds);
+    put_u32(p + 4, r.minutes);
+    put_u32(p + 8, r.hours);
+    put_u32(p + 12, r.days_low);
+    put_u32(p + 16, r.flags);
+}
+
+static rtc_regs_MBC3 get_regs(uint8_t const *p) {
+    rtc_regs_MBC3 r;
+    r.seconds = get_u32(p);
+    r.minutes = get_u32(p + 4);
+    r.hours = get_u32(p + 8);
+    r.days_low = get_u32(p + 12);
+    r.flags = get_u32(p + 16);
+    return r;
+}
 
+/* Clock state saved after the RAM banks: the clock and latched
+ * registers as 32 bit values, then the host time they were saved at
+ * in seconds as a 64 bit value, all little endian */
+static void save_rtc() {
+
+    int64_t now = host_seconds();
+    put_regs(RTC_save, get_rtc_regs(now));
+    put_regs(RTC_save + 20, latch_regs);
+    put_u32(RTC_save + 40, now);
+    put_u32(RTC_save + 44, (uint64_t)now >> 32);
+}
+
+/* Carry on from the saved clock, the time passed since
+ * it was saved is added on the next read */
+static void load_rtc() {
+
+    int64_t saved_at = get_u32(RTC_save + 40) | ((uint64_t)get_u32(RTC_save + 44) << 32);
+    if (saved_at == 0) { // No clock saved
+        rtc_start = host_seconds();
+        return;
+    }
+    set_rtc_regs(get_regs(RTC_save), saved_at);
+    latch_regs = get_regs(RTC_save + 20);
+}
 
 
 void setup_MBC3(int flags) {
@@ -52,6 +143,9 @@ void setup_MBC3(int flags) {
     if (battery) {
         read_SRAM();
     }
+    if (rtc_enabled) {
+        load_rtc();
+    }
 }
 
 uint8_t read_MBC3(uint16_t addr) {
@@ -73,7 +167,7 @@ uint8_t read_MBC3(uint16_t addr) {
         
      case 0xA000:
      case 0xB000: // Read from RAM bank (if RAM banking enabled)
-                if (ram_enabled && cur_RAM_bank <= 0x3) {
+                if (ram_enabled && cur_RAM_bank < (int)RAM_bank_count) {
                    return RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000)];
                 
 				// Read from RTC register
@@ -92,6 +186,24 @@ uint8_t read_MBC3(uint16_t addr) {
     return 0x0;
 }
 
+uint8_t const *bank_ptr_MBC3(uint16_t addr, unsigned *len) {
+
+    if (addr < 0x4000) {
+        *len = 0x4000 - addr;
+        return &ROM_banks[addr];
+    }
+    if (addr < 0x8000) {
+        *len = 0x8000 - addr;
+        return &ROM_banks[(cur_ROM_bank * ROM_BANK_SIZE) | (addr - 0x4000)];
+    }
+    // Clock registers aren't memory
+    if (ram_enabled && cur_RAM_bank < (int)RAM_bank_count) {
+        *len = 0xC000 - addr;
+        return &RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000)];
+    }
+    return NULL;
+}
+
 
 void write_MBC3(uint16_t addr, uint8_t val) {
 
@@ -100,6 +212,9 @@ void write_MBC3(uint16_t addr, uint8_t val) {
         case 0x1000: // Activate/Deactivate RAM banking/RTC
                     // From ON to OFF, save SRAM to file
                     if (battery && ram_enabled && ((val & 0xF) != 0xA) && sram_modified) {
+                        if (rtc_enabled) {
+                            save_rtc();
+                        }
                         write_SRAM();
                         sram_modified = 0;
                     }
@@ -111,25 +226,27 @@ void write_MBC3(uint16_t addr, uint8_t val) {
                     cur_ROM_bank = (val & 0x7F) + ((val & 0x7F) == 0);
                     break;
         case 0x4000: 
-        case 0x5000: // Set current RAM/RTC mode and banks
-                    cur_RAM_bank =  val & (RAM_bank_count - 1);
+        case 0x5000: // Set current RAM bank, or RTC register 0x8 - 0xC
+                    cur_RAM_bank = (val & 0x8) ? val : val & (RAM_bank_count - 1);
                     break;
         case 0x6000: 
         case 0x7000: //Latch to RTC reg if 0x0 followed by 0x1 written
                     if (ram_enabled && rtc_enabled) { 
                         if (last_latch == 0x0 && (val == 0x1)) {
-							 latch_regs = rtc_regs;
+							 latch_regs = get_rtc_regs(host_seconds());
                         }   
                         last_latch = val; 
                      }
                      break;
         case 0xA000:
         case 0xB000: // Write to external RAM bank if RAM banking enabled 
-                    if (ram_enabled && cur_RAM_bank <= 0x3) {
+                    if (ram_enabled && cur_RAM_bank < (int)RAM_bank_count) {
                         RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000)] = val;                       
                         sram_modified = 1;
                     // Write to RTC
                     } else if (ram_enabled && rtc_enabled) {
+                        int64_t now = host_seconds();
+                        rtc_regs_MBC3 rtc_regs = get_rtc_regs(now);
                     	switch (cur_RAM_bank) {
 							case 0x8: rtc_regs.seconds = val; break;
 							case 0x9: rtc_regs.minutes = val; break;
@@ -137,6 +254,8 @@ void write_MBC3(uint16_t addr, uint8_t val) {
 							case 0xB: rtc_regs.days_low = val; break;
 							case 0xC: rtc_regs.flags = val; break;	
 						}
+                        set_rtc_regs(rtc_regs, now);
+                        sram_modified = 1;
                     }
                     break;
     }    
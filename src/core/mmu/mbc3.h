@@ -4,10 +4,9 @@
 void set_rtc_MBC3();
 void write_rtc_MBC3();
 
-void inc_rtc_second();
-
 void setup_MBC3(int flags);
 uint8_t read_MBC3(uint16_t addr);
 void   write_MBC3(uint16_t addr, uint8_t val);
+uint8_t const *bank_ptr_MBC3(uint16_t addr, unsigned *len);
 
 #endif //MBC3_H
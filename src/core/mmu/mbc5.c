@@ -47,6 +47,23 @@ uint8_t read_MBC5(uint16_t addr) {
     return 0x0;
 }
 
+uint8_t const *bank_ptr_MBC5(uint16_t addr, unsigned *len) {
+
+    if (addr < 0x4000) {
+        *len = 0x4000 - addr;
+        return &ROM_banks[addr];
+    }
+    if (addr < 0x8000) {
+        *len = 0x8000 - addr;
+        return &ROM_banks[(((rom_bank_hi_bit << 8) | rom_bank_low) * ROM_BANK_SIZE) + (addr - 0x4000)];
+    }
+    if (ram_banking) {
+        *len = 0xC000 - addr;
+        return &RAM_banks[(cur_RAM_bank * RAM_BANK_SIZE) | (addr - 0xA000)];
+    }
+    return NULL;
+}
+
 
 void write_MBC5(uint16_t addr, uint8_t val) {
     
@@ -5,5 +5,6 @@
 void setup_MBC5(int flags);
 uint8_t read_MBC5(uint16_t addr);
 void   write_MBC5(uint16_t addr, uint8_t val);
+uint8_t const *bank_ptr_MBC5(uint16_t addr, unsigned *len);
 
 #endif //MBC5_H
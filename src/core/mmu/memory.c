@@ -14,12 +14,14 @@
 #include "../sound.h"
 #include "../serial_io.h"
 #include "../lcd.h"
+#include "../timers.h"
 
 #include "../../non_core/joypad.h"
 #include "../../non_core/logger.h"
 #include "../../non_core/files.h"
 
 #include <string.h>
+#include <stdlib.h>
 
 // UEFI libc won't link memmove
 #ifdef EFIAPI
@@ -382,14 +384,28 @@ void check_mmm01_format(unsigned char *file_data, size_t size) {
     }
 }
 
-int load_rom(char const *filename, uint8_t header[0x50], int const dmg_mode) {
+int load_rom(char const *filename, int const dmg_mode) {
 
     oam_mem_ptr = oam_mem;
  
     cgb = !dmg_mode;
     io_mem  = cgb ? io_mem_cgb : io_mem_dmg;
+    update_interrupt_pending();
 
-    uint8_t rom_bank_info = header[CARTRIDGE_ROM_SIZE - 0x100];
+    // Read the whole file once, the header is taken from what was read
+    uint8_t *file_data = malloc(MAX_FILE_SIZE);
+    if (file_data == NULL) {
+        log_message(LOG_ERROR, "Unable to allocate memory for ROM\n");
+        return 0;
+    }
+    size_t read_size = load_rom_from_file(filename, file_data);
+    if (read_size <= CHECKSUM_LSB) {
+        log_message(LOG_ERROR, "Error reading ROM header info\n");
+        free(file_data);
+        return 0;
+    }
+
+    uint8_t rom_bank_info = file_data[CARTRIDGE_ROM_SIZE];
     int rom_banks = 0;
     if (rom_bank_info <= 8) {
         rom_banks = 2 << rom_bank_info; 
@@ -401,12 +417,13 @@ int load_rom(char const *filename, uint8_t header[0x50], int const dmg_mode) {
             default: {
                 log_message(LOG_ERROR, "Unsupported value for ROM size in header: 0x%X\n"
                             , rom_bank_info);
+                free(file_data);
                 return 0;
             }
         }
     }
 
-    uint8_t ram_bank_info = header[CARTRIDGE_RAM_SIZE - 0x100];
+    uint8_t ram_bank_info = file_data[CARTRIDGE_RAM_SIZE];
     int ram_banks;
     switch (ram_bank_info) {
         case 0: ram_banks = 0;  break;
@@ -418,29 +435,31 @@ int load_rom(char const *filename, uint8_t header[0x50], int const dmg_mode) {
         default: {
             log_message(LOG_ERROR, "Unsupported value for RAM size in header: 0x%X\n"
                         , ram_bank_info);
+            free(file_data);
             return 0;
         }
     }
 
-    // Setup the memory bank controller 
-    if(!setup_MBC(header[CARTRIDGE_TYPE - 0x100], ram_banks, rom_banks, filename)) {
-        return 0;
-    }
-
-    size_t rom_size = rom_banks * ROM_BANK_SIZE;
-    size_t read_size;
-    if (!(read_size = load_rom_from_file(filename, ROM_banks))) {
-        log_message(LOG_ERROR, "failed to load ROM\n");
-        return 0;
-    }
-    
-    check_mmm01_format(ROM_banks, read_size);
-
     // Data read in doesn't match header information
+    size_t rom_size = rom_banks * ROM_BANK_SIZE;
     if (read_size != rom_size) {
 
         log_message(LOG_ERROR, "Error: Cartridge header info on its size (%lu bytes) \
             doesn't match file size (%lu bytes)\n",rom_size, read_size);
+        free(file_data);
+        return 0;
+    }
+
+    // Give back the rest of the buffer, keeping it all if that fails
+    uint8_t *rom = realloc(file_data, rom_size);
+    if (rom == NULL) {
+        rom = file_data;
+    }
+    check_mmm01_format(rom, rom_size);
+
+    // Setup the memory bank controller, which takes the ROM
+    if(!setup_MBC(rom[CARTRIDGE_TYPE], ram_banks, rom, filename)) {
+        free(rom);
         return 0;
     }
 
@@ -457,12 +476,240 @@ uint8_t *get_sprite_palette() {
     return sprite_palette_mem;
 }
 
+
+// Read from the second part of the CGB boot ROM, mapped to 0x200 - 0x8FF
+#define CGB_BOOT_ROM(addr) cgb_boot_rom[(addr) - 0x100]
+
+/* Decode the Nintendo logo from the cartridge header into tiles 1 - 24
+ * with the (R) symbol as tile 25. Each bit of the logo is doubled in
+ * width and height */
+static void boot_logo_tiles(uint8_t const *r_symbol) {
+
+    uint16_t dest = 0x8010;
+    for (uint16_t addr = NINTENDO_LOGO_START; addr <= NINTENDO_LOGO_END; addr++) {
+        uint8_t logo = get_mem(addr);
+        for (int nibble = 4; nibble >= 0; nibble -= 4) {
+            uint8_t row = 0;
+            for (int i = 0; i < 4; i++) {
+                if (logo & (BIT_0 << (nibble + i))) {
+                    row |= 0x3 << (i * 2);
+                }
+            }
+            set_mem(dest, row);
+            set_mem(dest + 2, row);
+            dest += 4;
+        }
+    }
+    for (int i = 0; i < 8; i++) {
+        set_mem(dest + (i * 2), r_symbol[i]);
+    }
+}
+
+// Place tiles 1 - 25 in the background map, as the DMG shows the logo
+static void boot_logo_map() {
+    set_mem(0x9910, 0x19);
+    for (int i = 0; i < 12; i++) {
+        set_mem(0x9904 + i, i + 1);
+        set_mem(0x9924 + i, i + 13);
+    }
+}
+
+/* Work out the palettes the CGB boot ROM gives a DMG only cartridge.
+ * Cartridges licensed by Nintendo are looked up by a checksum of their
+ * title, others get the default palettes. palettes is filled with
+ * the OBJ0, OBJ1 then BG0 palettes, checksum with the title checksum
+ * (0 if not licensed by Nintendo) and cycles with the time the boot
+ * ROM takes to look the title up.
+ * returns the number of the palette combination picked */
+static uint8_t boot_compat_palettes(uint8_t palettes[24], uint8_t *checksum, long *cycles) {
+
+    uint8_t index = 0;
+    int nintendo;
+    *checksum = 0;
+
+    // Checking the licensee stops at the first letter which doesn't match
+    if (get_mem(OLD_LICENSE_CODE) == 0x33) {
+        nintendo = get_mem(NEW_LICENSE_CODE_MSB) == '0' && get_mem(NEW_LICENSE_CODE_LSB) == '1';
+        *cycles = nintendo ? 672 : get_mem(NEW_LICENSE_CODE_MSB) == '0' ? 120 : 84;
+    } else {
+        nintendo = get_mem(OLD_LICENSE_CODE) == 0x01;
+        *cycles = nintendo ? 640 : 88;
+    }
+
+    if (nintendo) {
+        for (uint16_t addr = ROM_NAME_START; addr <= IS_COLOUR_COMPATIBLE; addr++) {
+            *checksum += get_mem(addr);
+        }
+        uint8_t i = 0;
+        while (i < 0x4F && CGB_BOOT_ROM(0x6C7 + i) != *checksum) {
+            i++;
+        }
+        if (i == 0x4F) {
+            *cycles += 3808;
+        } else if (i < 0x41) {
+            index = i;
+            *cycles += (i * 48) + 48;
+        } else {
+            // Titles with the same checksum are told apart by their 4th letter
+            *cycles += (i * 48) + 80;
+            for (; i < 0x5E; i += 0xE) {
+                if (CGB_BOOT_ROM(0x716 + i - 0x41) == get_mem(ROM_NAME_START + 3)) {
+                    index = i;
+                    *cycles += 40;
+                    break;
+                }
+                *cycles += 92;
+            }
+        }
+    }
+
+    /* Each entry picks one of the palette combinations, and how the 3
+     * palettes of each combination are taken from the list of palettes */
+    uint8_t entry = CGB_BOOT_ROM(0x733 + index);
+    uint8_t combination = entry & 0x1F;
+    uint8_t layout = entry >> 5;
+
+    uint8_t offsets[0x60];
+    memset(offsets, 0, sizeof(offsets));
+    uint16_t src = 0x791;
+    for (int i = 0; i < 0x5A; i += 3) {
+        offsets[i] = CGB_BOOT_ROM(src + ((layout & BIT_0) ? 0 : 2));
+        offsets[i + 1] = CGB_BOOT_ROM(src + ((layout & BIT_1) ? 0 : 2));
+        if (layout & BIT_2) {
+            offsets[i + 1] = CGB_BOOT_ROM(src + 1);
+        }
+        offsets[i + 2] = CGB_BOOT_ROM(src + 2);
+        src += 3;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        memcpy(palettes + (i * 8), &CGB_BOOT_ROM(0x7E8 + offsets[(combination * 3) + i]), 8);
+    }
+    return combination;
+}
+
+/* Leave the Gameboy as the boot ROM does when it hands over to
+ * the cartridge at 0x100, without running it. Must be called after
+ * load_rom and before the first instruction is executed */
+void skip_boot_rom() {
+
+    uint8_t const header_cgb = get_mem(IS_COLOUR_COMPATIBLE);
+
+    // Sound on, the chime has finished playing by the time the boot ROM ends
+    io_write_mem(NR_52_REG, 0x80);
+    io_write_mem(NR_11_REG, 0x80);
+    io_write_mem(NR_12_REG, 0xF3);
+    io_write_mem(NR_51_REG, 0xF3);
+    io_write_mem(NR_50_REG, 0x77);
+    io_write_mem(NR_13_REG, 0xC1);
+    io_write_mem(NR_14_REG, 0x07);
+    io_write_override(NR_14_REG, 0x87);
+
+    if (!cgb) {
+        boot_logo_tiles(dmg_boot_rom + 0xD8);
+        boot_logo_map();
+        io_write_mem(BGP_REF, 0xFC);
+        io_write_mem(LCDC_REG, 0x91);
+        io_write_mem(BOOT_ROM_DISABLE, 0x01);
+
+        // A is 0x01 for GB, flags are from adding up the header checksum
+        uint8_t sum = 0x19;
+        for (uint16_t addr = ROM_NAME_START; addr < COMPLEMENT_CHECKSUM; addr++) {
+            sum += get_mem(addr);
+        }
+        uint8_t complement = get_mem(COMPLEMENT_CHECKSUM);
+        uint8_t flags = ((uint8_t)(sum + complement) == 0 ? BIT_7 : 0)
+            | ((sum & 0xF) + (complement & 0xF) > 0xF ? BIT_5 : 0)
+            | (sum + complement > 0xFF ? BIT_4 : 0);
+        set_boot_registers(0x0100 | flags, 0x0013, 0x00D8, 0x014D);
+        lcd_set_vblank(4532);
+        set_divider(0xB6C4);
+        return;
+    }
+
+    for (uint8_t addr = WAVE_PATTERN_RAM_START; addr <= WAVE_PATTERN_RAM_END; addr++) {
+        io_write_mem(addr, (addr & 1) ? 0xFF : 0x00);
+    }
+    boot_logo_tiles(cgb_boot_rom + 0x72);
+    for (uint16_t addr = 0xFE00; addr < 0xFEA0; addr++) {
+        set_mem(addr, 0);
+    }
+
+    // The logo fades out to white
+    io_write_mem(BGPI, 0x80);
+    io_write_mem(SPPI, 0x80);
+    io_write_mem(SPPD, 0x00);
+    for (int i = 0; i < 0x40; i += 2) {
+        io_write_mem(BGPD, 0xFF);
+        io_write_mem(BGPD, 0x7F);
+    }
+    io_write_mem(VBANK_REG, 0);
+    io_write_mem(SRAM_BANK, 0);
+
+    if (header_cgb & BIT_7) {
+        io_write_mem(0x4C, header_cgb);
+        io_write_mem(BOOT_ROM_DISABLE, 0x11);
+        set_boot_registers(0x1180, 0x0000, 0xFF56, 0x000D);
+        lcd_set_vblank(168);
+        set_divider(0x8078);
+        return;
+    }
+
+    // DMG only cartridge, the boot ROM picks the palettes and leaves the joypad unselected
+    uint8_t palettes[24];
+    uint8_t checksum;
+    long lookup_cycles;
+    uint8_t combination = boot_compat_palettes(palettes, &checksum, &lookup_cycles);
+    io_write_mem(P1_REG, 0x30);
+    io_write_mem(0x4C, 0x04);
+    io_write_mem(0x6C, 0x01);
+    io_write_mem(BGPI, 0x80);
+    io_write_mem(SPPI, 0x80);
+    for (int i = 0; i < 16; i++) {
+        io_write_mem(SPPD, palettes[i]);
+    }
+    for (int i = 16; i < 24; i++) {
+        io_write_mem(BGPD, palettes[i]);
+    }
+
+    /* The boot ROM ends later for later palette combinations, 32 cycles
+     * for each. The time taken to look the title up happens before
+     * waiting for V-Blank, checked every 24 cycles, so only shifts the
+     * end by up to 8 cycles either way. Showing the logo takes longer */
+    long shift = (lookup_cycles - 88) % 24;
+    long cycles = 1284 + (combination * 32) + (shift <= 8 ? shift : shift - 24);
+    uint16_t hl = 0x007C;
+    uint16_t return_addr = 0x05F5;
+    // A couple of titles still show the logo in the background map
+    if (checksum == cgb_boot_rom[0x7A] || checksum == cgb_boot_rom[0x7B]) {
+        boot_logo_map();
+        cycles += checksum == cgb_boot_rom[0x7A] ? 1400 : 1440;
+        hl = 0x991A;
+        return_addr = 0x0603;
+    }
+    // Left on the stack by the last calls made
+    set_mem(0xFFF6, 0x00);
+    set_mem_16(0xFFFA, return_addr);
+    io_write_mem(BOOT_ROM_DISABLE, 0x11);
+    set_boot_registers(0x1180, checksum << 8, 0x0008, hl);
+    lcd_set_vblank(cycles);
+    set_divider(0x7FD0 + cycles);
+}
+
+// Rows waiting to be rendered need the state from before the write
+static inline void render_state_written() {
+    if (deferred_rows) {
+        render_deferred_rows();
+    }
+}
+
 /* Write to OAM given OAM address 0x0 - 0xA0
  * Does nothing if address > 0xA0 */
 static void oam_set_mem(uint8_t addr, uint8_t val) {
     
     // Check not unusable RAM (i.e. not 0xFEA0 - 0xFEFF)
     if (addr < 0xA0) {
+        render_state_written();
         oam_mem[addr] = val;
         /* If Object X position is written to, reorganise
          * sprite priorities for rendering */
@@ -481,9 +728,8 @@ static void oam_set_mem(uint8_t addr, uint8_t val) {
  * address XX00 */
 static void dma_transfer(uint8_t val) {        
     uint16_t source_addr = val << 8;
-    for (int i = 0; i < 0xA0; i++) {
-        oam_mem[i] = get_mem(source_addr + i);
-    }
+    render_state_written();
+    copy_from_mem(oam_mem, source_addr, 0xA0);
 }
 
 
@@ -525,11 +771,22 @@ void io_write_mem(uint8_t addr, uint8_t val) {
         return;
     }
 
+    if (addr >= LCDC_REG && addr <= WX_REG && io_mem[addr] != val) {
+        // DMA flushes the rows itself, only once OAM is written
+        if (is_raster_register(addr)) {
+            render_state_written();
+        }
+        lcd_register_written(addr, val);
+    }
+
     switch (addr) {
         /* Check Joypad values */
         case P1_REG  : io_mem[addr] = val; joypad_write(val); break;
         /*  Attempting to set DIV reg resets it to 0 */
-        case DIV_REG  : io_mem[addr] = 0 ;break; 
+        case DIV_REG  :
+        case TIMA_REG :
+        case TMA_REG  :
+        case TAC_REG  : timer_reg_written(addr, val); break;
         
         case LCDC_REG: {
             uint8_t current_lcdc = io_mem[addr];
@@ -689,6 +946,9 @@ void io_write_mem(uint8_t addr, uint8_t val) {
                        // uint8_t address = bgpi & 0x3F
                        // uint8_t index = bgpi & 0x3F;
                         int old_palette_mem = bg_palette_mem[bgpi & 0x3F];
+                        if (old_palette_mem != val) {
+                            render_state_written();
+                        }
                         bg_palette_mem[bgpi & 0x3F] = val;
                         bg_palette_dirty |= (old_palette_mem != val);
 
@@ -724,6 +984,9 @@ void io_write_mem(uint8_t addr, uint8_t val) {
                          * to write the value to in Sprite Palette memory */
                         uint8_t sppi = io_mem[SPPI];
                         uint8_t old_val = sprite_palette_mem[sppi & 0x3F];
+                        if (old_val != val) {
+                            render_state_written();
+                        }
                         sprite_palette_mem[sppi & 0x3F] = val;
                         sprite_palette_dirty |= (old_val != val);
                         
@@ -783,9 +1046,16 @@ void io_write_mem(uint8_t addr, uint8_t val) {
             break;
 
         case BOOT_ROM_DISABLE: 
+            render_state_written();
             is_booting = 0;
             break;
 
+        case INTERRUPT_REG :
+        case INTERRUPT_ENABLE_REG :
+            io_mem[addr] = val;
+            update_interrupt_pending();
+            break;
+
        default:
             io_mem[addr] = val;
             break;
@@ -803,6 +1073,7 @@ int interrupt_about_to_raise() {
  * and not the CPU. */
 void io_write_override(uint8_t addr, uint8_t val) {
    io_mem[addr] = val;
+   update_interrupt_pending();
 }
 
 
@@ -826,7 +1097,19 @@ void set_mem(uint16_t addr, uint8_t const val) {
 
         // Check if writting to alternative VRAM with Gameboy Color
         if (cgb && cgb_vram_bank && addr >= 0x8000 && addr < 0xA000) {
-            vram_bank_1[addr - 0x8000] = val;
+            if (vram_bank_1[addr - 0x8000] != val) {
+                render_state_written();
+                vram_bank_1[addr - 0x8000] = val;
+                vram_written(addr, 1);
+            }
+            return;
+        }
+
+        // Let the renderer know VRAM has changed
+        if (addr < 0xA000 && mem[addr - 0x8000] != val) {
+            render_state_written();
+            mem[addr - 0x8000] = val;
+            vram_written(addr, 0);
             return;
         }
 
@@ -876,6 +1159,10 @@ uint8_t get_vram0(uint16_t addr) {
     return mem[addr - 0x8000];
 }
 
+uint8_t *get_vram_bank(int bank) {
+    return bank ? vram_bank_1 : mem;
+}
+
 // Read contents from given 16 bit memory address
 uint8_t get_mem(uint16_t addr) {
    
@@ -918,11 +1205,114 @@ uint8_t get_mem(uint16_t addr) {
         return oam_get_mem(addr - 0xFE00);
     }
     // Read from IO mem
-    if (addr >= 0xFF10 && addr <= 0xFF3F) {
-        return read_apu(addr);
+    return io_read_mem(addr - 0xFF00);
+
+}
+
+/* Read from IO memory given address 0 - 0xFF */
+uint8_t io_read_mem(uint8_t addr) {
+
+    if (addr >= 0x10 && addr <= 0x3F) {
+        return read_apu(addr + 0xFF00);
+    }
+    // Timer registers are only updated when read
+    if (addr == DIV_REG || addr == TIMA_REG) {
+        sync_timers();
+    }
+    return io_mem[addr];
+}
+
+
+/* Obtain a pointer to the given address if it's in VRAM, WRAM
+ * (including echo RAM) or a cartridge bank as read by get_mem, along
+ * with the number of bytes until the end of that region. NULL for
+ * any other memory */
+static uint8_t const *mem_region(uint16_t addr, unsigned *region_len) {
+
+    if (addr >= 0x8000 && addr < 0xA000) {
+        *region_len = 0xA000 - addr;
+        if (cgb && cgb_vram_bank && (is_booting || cgb_features)) {
+            return &vram_bank_1[addr - 0x8000];
+        }
+        return &mem[addr - 0x8000];
+    }
+    if (addr < 0xC000) {
+        // The boot ROM is mapped over parts of the cartridge ROM
+        if (bank_ptr_MBC == NULL || (is_booting && (addr < 0x100 || (cgb && addr >= 0x200 && addr < 0x900)))) {
+            return NULL;
+        }
+        uint8_t const *bank = bank_ptr_MBC(addr, region_len);
+        if (is_booting && cgb && addr < 0x200 && *region_len > (unsigned)(0x200 - addr)) {
+            *region_len = 0x200 - addr;
+        }
+        return bank;
+    }
+    if (addr >= 0xFDFF) {
+        return NULL;
     }
-    return io_mem[addr - 0xFF00];
 
+    // Each 4KB of WRAM may be a different bank, 0xFDFF isn't echoed
+    *region_len = (addr < 0xF000 ? (addr & 0xF000) + 0x1000 : 0xFDFF) - addr;
+    if (addr >= ECHO_RAM_START) {
+        addr -= 0x2000;
+    }
+
+    if (cgb && cgb_ram_bank > 1 && addr >= 0xD000) {
+        return &cgb_ram_banks[cgb_ram_bank - 2][addr - 0xD000];
+    }
+    return &mem[addr - 0x8000];
+}
+
+/* Read len bytes starting at source into dest. VRAM, WRAM and the
+ * cartridge banks mapped in are copied a region at a time, anything
+ * else (OAM, IO, clock registers) a byte at a time through get_mem */
+void copy_from_mem(uint8_t *dest, uint16_t source, unsigned len) {
+
+    while (len > 0) {
+        unsigned region_len;
+        uint8_t const *region = mem_region(source, &region_len);
+        if (region == NULL) {
+            *dest++ = get_mem(source++);
+            len--;
+            continue;
+        }
+        unsigned n = region_len < len ? region_len : len;
+        memcpy(dest, region, n);
+        dest += n;
+        source += n;
+        len -= n;
+    }
+}
+
+/* Copy len bytes from source to dest in VRAM (0x8000 - 0x9FFF), as if
+ * written with set_mem. Any bytes past the end of VRAM are written
+ * a byte at a time */
+void copy_to_vram(uint16_t dest, uint16_t source, unsigned len) {
+
+    uint8_t buffer[0x800];
+    while (len > 0) {
+        unsigned n = len < sizeof(buffer) ? len : sizeof(buffer);
+        if (dest < 0x8000 || dest >= 0xA000) {
+            set_mem(dest++, get_mem(source++));
+            len--;
+            continue;
+        }
+        if (n > (unsigned)(0xA000 - dest)) {
+            n = 0xA000 - dest;
+        }
+        copy_from_mem(buffer, source, n);
+
+        int bank = cgb && cgb_vram_bank;
+        uint8_t *vram = (bank ? vram_bank_1 : mem) + (dest - 0x8000);
+        if (memcmp(vram, buffer, n) != 0) {
+            render_state_written();
+            memcpy(vram, buffer, n);
+            vram_range_written(dest, n, bank);
+        }
+        dest += n;
+        source += n;
+        len -= n;
+    }
 }
 
 
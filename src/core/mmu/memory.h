@@ -35,15 +35,27 @@ uint8_t get_vram(uint16_t addr, int bank);
 
 uint8_t get_vram0(uint16_t addr);
 
+// Obtain the 0x2000 bytes of the given VRAM bank (0 or 1)
+uint8_t *get_vram_bank(int bank);
+
 uint8_t get_vram1(uint16_t addr);
 
 uint8_t oam_get_mem(uint8_t addr);
 
 void io_write_mem(uint8_t addr, uint8_t val);
 
+uint8_t io_read_mem(uint8_t addr);
+
 // Read contents from given 16 bit memory address
 uint8_t get_mem(uint16_t addr);
 
+/* Read len bytes starting at the given address into dest */
+void copy_from_mem(uint8_t *dest, uint16_t source, unsigned len);
+
+/* Copy len bytes from source to the VRAM address dest
+ * as if each were written with set_mem */
+void copy_to_vram(uint16_t dest, uint16_t source, unsigned len);
+
 /*  Write an 8 bit value to the given 16 bit address */
 void set_mem(uint16_t addr, uint8_t const val);
 
@@ -56,9 +68,17 @@ void set_mem_16(uint16_t const loc, uint16_t const val);
  * given address. Returned as little-endian byte order 16 bit value */
 uint16_t get_mem_16(uint16_t const loc); 
     
-/* Given the ROM data, load the ROM into
- * Gameboy memory and setup banks */
-int load_rom(char const * filename, uint8_t header[0x50], int const dmg_mode);
+/* Directly inject a value into IO memory without performing
+ * any checks or operations on the data */
+void io_write_override(uint8_t addr, uint8_t val);
+
+/* Load the ROM file into Gameboy memory and
+ * setup banks from its header */
+int load_rom(char const * filename, int const dmg_mode);
+
+/* Leave the Gameboy as the boot ROM does when it hands over to
+ * the cartridge at 0x100, without running it */
+void skip_boot_rom();
 
 // deallocate all allocated memory
 void teardown_memory();
@@ -54,6 +54,27 @@ uint8_t read_MMM01(uint16_t addr) {
      return 0x00;
 }
 
+uint8_t const *bank_ptr_MMM01(uint16_t addr, unsigned *len) {
+
+    if (addr < 0x8000 && rom_mode == 0) {
+        *len = 0x8000 - addr;
+        return &ROM_banks[addr];
+    }
+    if (addr < 0x4000) {
+        *len = 0x4000 - addr;
+        return &ROM_banks[((rom_base + 2) * ROM_BANK_SIZE) | addr];
+    }
+    if (addr < 0x8000) {
+        *len = 0x8000 - addr;
+        return &ROM_banks[((1 + rom_base + rom_select) * ROM_BANK_SIZE) + addr];
+    }
+    if (ram_banking) {
+        *len = 0xC000 - addr;
+        return &RAM_banks[(ram_select * RAM_BANK_SIZE) | (addr & 0x1FFF)];
+    }
+    return NULL;
+}
+
 
 
 
@@ -5,5 +5,6 @@
 void setup_MMM01(int flags);
 uint8_t read_MMM01(uint16_t addr);
 void   write_MMM01(uint16_t addr, uint8_t val);
+uint8_t const *bank_ptr_MMM01(uint16_t addr, unsigned *len);
 
 #endif //MMM01_H
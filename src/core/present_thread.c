@@ -0,0 +1,151 @@
+#ifdef RENDER_THREAD
+
+#include <pthread.h>
+#include <string.h>
+
+#include "present_thread.h"
+
+#include "../non_core/framerate.h"
+#include "../non_core/logger.h"
+
+/* Triple buffered frame hand off. The emulator thread owns back_buffer
+ * and the presentation thread owns front_buffer, latest is swapped
+ * atomically with either. LATEST_FRESH is set in latest when it holds
+ * a frame which hasn't been displayed yet.
+ *
+ * The presentation thread waits for the framerate, then displays the
+ * latest frame if there is a new one. The emulator thread is allowed
+ * to finish at most one frame ahead of the frames waited for. */
+#define LATEST_FRESH 0x100
+#define LATEST_BUFFER 0xFF
+
+static uint32_t buffers[PRESENT_BUFFERS][144 * 160];
+static int back_buffer = 0;
+static int front_buffer = 1;
+static int latest = 2;
+
+static uint64_t frames_finished = 0; // Frames published or paced by the emulator
+static uint64_t frames_waited = 0; // Framerate periods waited by the presentation thread
+static unsigned long frames_presented = 0;
+static unsigned long frames_dropped = 0;
+
+static int running = 0;
+static int stopping = 0;
+static pthread_t presenter;
+static pthread_mutex_t pace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pace_cond = PTHREAD_COND_INITIALIZER;
+
+
+// Swap the front buffer for the latest frame and display it if not already
+static void present_latest() {
+
+    if (!(__atomic_load_n(&latest, __ATOMIC_ACQUIRE) & LATEST_FRESH)) {
+        return;
+    }
+
+    int previous = __atomic_exchange_n(&latest, front_buffer, __ATOMIC_ACQ_REL);
+    front_buffer = previous & LATEST_BUFFER;
+    present_frame(buffers[front_buffer]);
+    __atomic_add_fetch(&frames_presented, 1, __ATOMIC_RELAXED);
+}
+
+static void *present_worker(void *arg) {
+    (void)arg;
+
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        adjust_to_framerate();
+        present_latest();
+
+        pthread_mutex_lock(&pace_mutex);
+        frames_waited++;
+        pthread_cond_signal(&pace_cond);
+        pthread_mutex_unlock(&pace_mutex);
+    }
+    return NULL;
+}
+
+
+int get_back_buffer() {
+    return back_buffer;
+}
+
+uint32_t *get_present_buffer(int buffer) {
+    return buffers[buffer];
+}
+
+void pace_frame() {
+
+    pthread_mutex_lock(&pace_mutex);
+    frames_finished++;
+    while (frames_finished > frames_waited + 1 && !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        pthread_cond_wait(&pace_cond, &pace_mutex);
+    }
+    pthread_mutex_unlock(&pace_mutex);
+}
+
+void publish_frame() {
+
+    int previous = __atomic_exchange_n(&latest, back_buffer | LATEST_FRESH, __ATOMIC_ACQ_REL);
+    back_buffer = previous & LATEST_BUFFER;
+
+    // Replaced before the presentation thread got to it
+    if (previous & LATEST_FRESH) {
+        __atomic_add_fetch(&frames_dropped, 1, __ATOMIC_RELAXED);
+    }
+
+    pace_frame();
+}
+
+void get_present_stats(unsigned long *presented, unsigned long *dropped) {
+    *presented = __atomic_load_n(&frames_presented, __ATOMIC_RELAXED);
+    *dropped = __atomic_load_n(&frames_dropped, __ATOMIC_RELAXED);
+}
+
+
+int start_present_thread() {
+
+    if (running) {
+        return 1;
+    }
+
+    back_buffer = 0;
+    front_buffer = 1;
+    latest = 2;
+    frames_finished = 0;
+    frames_waited = 0;
+    stopping = 0;
+
+    if (pthread_create(&presenter, NULL, present_worker, NULL) != 0) {
+        log_message(LOG_ERROR, "Failed to start presentation thread\n");
+        return 0;
+    }
+
+    running = 1;
+    log_message(LOG_INFO, "Presenting frames on a separate thread\n");
+    return 1;
+}
+
+void stop_present_thread() {
+
+    if (!running) {
+        return;
+    }
+
+    pthread_mutex_lock(&pace_mutex);
+    __atomic_store_n(&stopping, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&pace_cond);
+    pthread_mutex_unlock(&pace_mutex);
+    pthread_join(presenter, NULL);
+
+    // The last frame may not have been displayed yet
+    present_latest();
+    running = 0;
+
+    log_message(LOG_INFO, "Frames presented: %d, dropped: %d\n", (int)frames_presented, (int)frames_dropped);
+}
+
+int present_thread_running() {
+    return running;
+}
+
+#endif /* RENDER_THREAD */
@@ -0,0 +1,41 @@
+#ifndef PRESENT_THREAD_H
+#define PRESENT_THREAD_H
+
+#include <stdint.h>
+
+/* Finished frames are handed to the presentation thread through
+ * 3 buffers: one being rendered into, one being displayed and
+ * the latest finished frame waiting to be displayed */
+#define PRESENT_BUFFERS 3
+
+/* Display a finished frame, only called from the
+ * presentation thread (implemented in graphics.c) */
+void present_frame(uint32_t const *frame);
+
+/* Start displaying frames on a separate thread, which also paces
+ * the emulator to the framerate instead of the emulator thread.
+ * returns 1 if successful, 0 otherwise */
+int start_present_thread();
+
+// Display the latest published frame and stop the presentation thread
+void stop_present_thread();
+
+int present_thread_running();
+
+// Buffer number (0 - PRESENT_BUFFERS - 1) the next frame is rendered into
+int get_back_buffer();
+
+uint32_t *get_present_buffer(int buffer);
+
+/* Publish the back buffer as the latest finished frame, replacing any
+ * frame which hasn't been displayed yet, then wait for the next frame */
+void publish_frame();
+
+// Wait for the next frame without publishing one, for skipped frames
+void pace_frame();
+
+/* Obtain the number of frames displayed and how many
+ * were replaced by a newer frame before being displayed */
+void get_present_stats(unsigned long *presented, unsigned long *dropped);
+
+#endif /* PRESENT_THREAD_H */
@@ -0,0 +1,259 @@
+#ifdef RENDER_THREAD
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "render_thread.h"
+#include "mmu/memory.h"
+#include "memory_layout.h"
+#include "sprite_priorities.h"
+
+#include "../non_core/logger.h"
+
+/* Lines are passed to the render thread through a single producer
+ * single consumer ring of line records. The emulator thread owns
+ * ring_head and the render thread owns ring_tail, each only ever
+ * increments its own counter.
+ *
+ * VRAM is shared copy on write, each record points to pages which are
+ * never modified once queued. A written to page is copied into a
+ * fresh page from the pool before the next record is queued, the page
+ * it replaced is reused once the render thread has moved past it. */
+#define RING_SIZE 256 // Must be a power of 2
+#define POOL_PAGES (2 * VRAM_PAGES * 8)
+#define PAGE_IN_USE UINT64_MAX
+#define SPIN_LIMIT 2000
+
+static Line_State ring[RING_SIZE];
+static uint64_t ring_head = 0; // Records queued
+static uint64_t ring_tail = 0; // Records rendered
+
+static uint8_t page_pool[POOL_PAGES][VRAM_PAGE_SIZE];
+/* Value of ring_tail at which each page is free to be reused,
+ * PAGE_IN_USE if it's the latest copy of a VRAM page */
+static uint64_t page_free_at[POOL_PAGES];
+static int current_pages[2][VRAM_PAGES]; // Pool index of the latest copy of each VRAM page
+static uint32_t dirty_pages = 0; // 1 bit per page, bank 0 in the low bits
+static int next_free_page = 0;
+static bool palettes_need_copy = false;
+
+static bool running = false;
+static int stopping = 0;
+static int worker_sleeping = 0;
+static pthread_t worker;
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_wake = PTHREAD_COND_INITIALIZER;
+
+
+// Block the render thread until there are lines to render or it's stopping
+static void worker_wait(uint64_t rendered) {
+
+    for (int i = 0; i < SPIN_LIMIT; i++) {
+        if (__atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) != rendered ||
+            __atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+    }
+
+    /* The emulator thread checks worker_sleeping after publishing a
+     * record, so either it sees the flag or this sees the new record */
+    pthread_mutex_lock(&worker_mutex);
+    __atomic_store_n(&worker_sleeping, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&ring_head, __ATOMIC_SEQ_CST) == rendered &&
+           !__atomic_load_n(&stopping, __ATOMIC_SEQ_CST)) {
+        pthread_cond_wait(&worker_wake, &worker_mutex);
+    }
+    __atomic_store_n(&worker_sleeping, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&worker_mutex);
+}
+
+static void wake_worker() {
+    if (__atomic_load_n(&worker_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&worker_mutex);
+        pthread_cond_signal(&worker_wake);
+        pthread_mutex_unlock(&worker_mutex);
+    }
+}
+
+static void *render_worker(void *arg) {
+    (void)arg;
+    uint64_t rendered = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+
+    for (;;) {
+        if (__atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) == rendered) {
+            if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            worker_wait(rendered);
+            continue;
+        }
+
+        render_line(&ring[rendered & (RING_SIZE - 1)]);
+        rendered++;
+        __atomic_store_n(&ring_tail, rendered, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+
+static uint64_t lines_rendered() {
+    return __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE);
+}
+
+// Obtain a page from the pool, waiting for the render thread if none are free
+static int alloc_page() {
+
+    for (;;) {
+        uint64_t rendered = lines_rendered();
+        for (int i = 0; i < POOL_PAGES; i++) {
+            int page = (next_free_page + i) % POOL_PAGES;
+            if (page_free_at[page] <= rendered) {
+                next_free_page = (page + 1) % POOL_PAGES;
+                page_free_at[page] = PAGE_IN_USE;
+                return page;
+            }
+        }
+        wake_worker();
+        sched_yield();
+    }
+}
+
+// Copy every page written to since the last line was queued
+static void copy_dirty_pages(uint64_t line_no) {
+
+    while (dirty_pages) {
+        int bit = __builtin_ctz(dirty_pages);
+        dirty_pages &= dirty_pages - 1;
+
+        int bank = bit / VRAM_PAGES;
+        int page = bit % VRAM_PAGES;
+        int new_page = alloc_page();
+        memcpy(page_pool[new_page], get_vram_bank(bank) + (page * VRAM_PAGE_SIZE), VRAM_PAGE_SIZE);
+
+        /* The old copy is last used by the line before this one, so
+         * is free once this line has been rendered too */
+        page_free_at[current_pages[bank][page]] = line_no + 1;
+        current_pages[bank][page] = new_page;
+    }
+}
+
+
+void render_thread_vram_written(uint16_t addr, int bank) {
+    dirty_pages |= 1u << ((bank * VRAM_PAGES) + ((addr - TILE_SET_0_START) / VRAM_PAGE_SIZE));
+}
+
+void queue_line(Raster_Writes const *writes) {
+
+    uint64_t line_no = ring_head;
+    // Wait for space in the ring
+    while (line_no - lines_rendered() >= RING_SIZE) {
+        wake_worker();
+        sched_yield();
+    }
+
+    copy_dirty_pages(line_no);
+
+    Line_State *ls = &ring[line_no & (RING_SIZE - 1)];
+    memcpy(ls->regs, &io_mem[LCDC_REG], LCD_REG_COUNT);
+    ls->is_booting = is_booting;
+    memcpy(ls->oam, oam_mem_ptr, sizeof(ls->oam));
+    get_sprite_prio_order(ls->sprite_order);
+
+    ls->palettes_dirty = 0;
+    if (bg_palette_dirty || palettes_need_copy) {
+        memcpy(ls->bg_palette, get_bg_palette(), sizeof(ls->bg_palette));
+        ls->palettes_dirty |= LINE_BG_PALETTE_DIRTY;
+        bg_palette_dirty = false;
+    }
+    if (sprite_palette_dirty || palettes_need_copy) {
+        memcpy(ls->sprite_palette, get_sprite_palette(), sizeof(ls->sprite_palette));
+        ls->palettes_dirty |= LINE_SPRITE_PALETTE_DIRTY;
+        sprite_palette_dirty = false;
+    }
+    palettes_need_copy = false;
+
+    for (int bank = 0; bank < 2; bank++) {
+        for (int page = 0; page < VRAM_PAGES; page++) {
+            ls->vram_pages[bank][page] = page_pool[current_pages[bank][page]];
+        }
+    }
+
+    ls->raster.count = 0;
+    if (writes != NULL) {
+        memcpy(&ls->raster, writes, sizeof(ls->raster));
+    }
+
+    __atomic_store_n(&ring_head, line_no + 1, __ATOMIC_SEQ_CST);
+    wake_worker();
+}
+
+void wait_for_render_thread() {
+    if (!running) {
+        return;
+    }
+
+    while (lines_rendered() != ring_head) {
+        wake_worker();
+        sched_yield();
+    }
+}
+
+
+int start_render_thread() {
+
+    if (running) {
+        return 1;
+    }
+
+    /* Every page is copied and the palettes sent with the
+     * first line, the pool starts out entirely free */
+    for (int i = 0; i < POOL_PAGES; i++) {
+        page_free_at[i] = 0;
+    }
+    for (int bank = 0; bank < 2; bank++) {
+        for (int page = 0; page < VRAM_PAGES; page++) {
+            current_pages[bank][page] = (bank * VRAM_PAGES) + page;
+            page_free_at[current_pages[bank][page]] = PAGE_IN_USE;
+        }
+    }
+    dirty_pages = UINT32_MAX;
+    palettes_need_copy = true;
+    next_free_page = 0;
+
+    ring_head = 0;
+    ring_tail = 0;
+    stopping = 0;
+    worker_sleeping = 0;
+
+    if (pthread_create(&worker, NULL, render_worker, NULL) != 0) {
+        log_message(LOG_ERROR, "Failed to start render thread\n");
+        return 0;
+    }
+
+    running = true;
+    log_message(LOG_INFO, "Rendering on a separate thread\n");
+    return 1;
+}
+
+void stop_render_thread() {
+
+    if (!running) {
+        return;
+    }
+
+    __atomic_store_n(&stopping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&worker_mutex);
+    pthread_cond_signal(&worker_wake);
+    pthread_mutex_unlock(&worker_mutex);
+    pthread_join(worker, NULL);
+
+    running = false;
+}
+
+int render_thread_running() {
+    return running;
+}
+
+#endif /* RENDER_THREAD */
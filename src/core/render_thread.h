@@ -0,0 +1,74 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <stdint.h>
+#include "sprite_priorities.h"
+
+/* VRAM is snapshotted for the render thread in pages, only pages
+ * written to since the last snapshot are copied */
+#define VRAM_PAGE_SIZE 0x200
+#define VRAM_PAGES (0x2000 / VRAM_PAGE_SIZE) // Per bank
+
+#define LCD_REG_COUNT 0xC // LCDC - WX (0xFF40 - 0xFF4B)
+
+/* Writes to LCD registers made during mode 3 of a line, in order. The
+ * line is rendered in segments, each with the registers as they were at
+ * that point along it */
+#define MAX_RASTER_WRITES 64
+#define RASTER_START_CYCLE 12 // Mode 3 cycles before the first pixel is output
+
+typedef struct {
+    uint16_t cycle; // Cycles into mode 3
+    uint8_t reg; // Offset from LCDC_REG
+    uint8_t value;
+} Raster_Write;
+
+typedef struct {
+    uint8_t start_regs[LCD_REG_COUNT]; // Registers before the first write
+    int count;
+    Raster_Write writes[MAX_RASTER_WRITES];
+} Raster_Writes;
+
+#define LINE_BG_PALETTE_DIRTY 0x1
+#define LINE_SPRITE_PALETTE_DIRTY 0x2
+
+/* Everything read by the renderer to draw a scanline, recorded
+ * at the start of LCD mode 3 for the line */
+typedef struct {
+    uint8_t regs[LCD_REG_COUNT];
+    uint8_t is_booting;
+    uint8_t palettes_dirty; // Palette copies are only valid if marked dirty
+    uint8_t oam[0xA0];
+    uint8_t sprite_order[MAX_SPRITES]; // Sprite numbers, highest priority first
+    uint8_t bg_palette[0x40];
+    uint8_t sprite_palette[0x40];
+    uint8_t const *vram_pages[2][VRAM_PAGES]; // Copy on write pages, never modified once queued
+    Raster_Writes raster; // Only valid if count is non zero
+} Line_State;
+
+/* Render a scanline from a line record, only called
+ * from the render thread (implemented in graphics.c) */
+void render_line(Line_State const *ls);
+
+/* Start rendering queued lines on a separate thread
+ * returns 1 if successful, 0 otherwise */
+int start_render_thread();
+
+// Finish rendering all queued lines and stop the render thread
+void stop_render_thread();
+
+int render_thread_running();
+
+/* Record the current state of the line in LY and queue it for the
+ * render thread, along with the writes made to the LCD registers during
+ * the line if writes isn't NULL */
+void queue_line(Raster_Writes const *writes);
+
+// Wait for the render thread to finish all queued lines
+void wait_for_render_thread();
+
+/* Mark the page containing the given VRAM address to be
+ * copied before the next line is queued */
+void render_thread_vram_written(uint16_t addr, int bank);
+
+#endif /* RENDER_THREAD_H */
@@ -7,9 +7,12 @@
 #include "serial_io.h"
 #include "../non_core/serial_io_transfer.h"
 
-static int transfer_in_progress = 0;
+// An external clock transfer polls the link once per scanline
+#define SERIAL_POLL_CYCLES 456
+
+int serial_transfer_in_progress = 0;
 static int internal_clock = 0;
-static unsigned cur_cycles = 0;
+static long cycles_to_event = 0; // Until an internal transfer completes or the next poll
 static unsigned gb_io_freq = 8192;
 
 static uint8_t *recieved_location;
@@ -32,37 +35,48 @@ void start_transfer(uint8_t *ctl, uint8_t *data) {
     data_to_send = *data;
     control = ctl;
     recieved_location = data;
-    transfer_in_progress = !!(*control & 0x80);
+    serial_transfer_in_progress = !!(*control & 0x80);
     internal_clock = *control & 0x1;
-    cur_cycles = 0;
+    // External transfers poll straight away
+    cycles_to_event = internal_clock ? (GB_CLOCK_SPEED_HZ / gb_io_freq) : 0;
+}
+
+void serial_data_ready() {
+    if (serial_transfer_in_progress && !internal_clock) {
+        cycles_to_event = 0;
+    }
+}
+
+static void finish_transfer(uint8_t result) {
+    *recieved_location = result;
+    raise_interrupt(IO_INT);
+    *control &= (0x7F);
+    serial_transfer_in_progress = 0;
+    internal_clock = 0;
 }
 
 /* Add cycles to the serial transfer,
  * used to ensure when using internal clock,
  * data is transfered at the correct clock speed */
 void inc_serial_cycles(unsigned cycles) {
-    if (transfer_in_progress && internal_clock) {
-        cur_cycles += cycles;
-        if (cur_cycles >=  (GB_CLOCK_SPEED_HZ / gb_io_freq)) {
-           cur_cycles = 0;
-           *recieved_location = transfer_int(data_to_send);
-           raise_interrupt(IO_INT); 
-           *control &= (0x7F);     
-           transfer_in_progress = 0;
-           internal_clock = 0;
-        }     
+    if (!serial_transfer_in_progress) {
+        return;
+    }
+    cycles_to_event -= cycles;
+    if (cycles_to_event > 0) {
+        return;
     }
 
-    // Poll external transfer
-    if (transfer_in_progress && !internal_clock) {
-        uint8_t result;
-        int complete;
-        if ((complete = transfer_ext(data_to_send, &result))) {
-            *recieved_location = result;
-            raise_interrupt(IO_INT);
-            *control &= (0x7F);
-            transfer_in_progress = 0;
-        } 
+    if (internal_clock) {
+        finish_transfer(transfer_int(data_to_send));
+        return;
     }
 
+    // Poll external transfer
+    uint8_t result;
+    if (transfer_ext(data_to_send, &result)) {
+        finish_transfer(result);
+    } else {
+        cycles_to_event = SERIAL_POLL_CYCLES;
+    }
 }
@@ -7,6 +7,9 @@
 
 typedef enum {CLIENT = 0, SERVER = 1, NO_CONNECT = 2} ClientOrServer;
 
+// Set while a transfer is waiting to complete
+extern int serial_transfer_in_progress;
+
 
 int setup_serial_io(ClientOrServer cs, unsigned port);
 
@@ -20,4 +23,9 @@ void start_transfer(uint8_t *control, uint8_t *data);
  * data is transfered at the correct clock speed */
 void inc_serial_cycles(unsigned cycles);
 
+/* Let a waiting externally clocked transfer know the link has
+ * data for it, so it's polled on the next update instead of
+ * at the next scanline */
+void serial_data_ready();
+
 #endif
@@ -2,100 +2,84 @@
 #include "sprite_priorities.h"
 #include "rom_info.h"
 
-struct node {
-    uint16_t x_pos;
-    struct node *prev; // Next node with higher priority
-    struct node *next; // Next node with lower priority       
-};
-
-
-/* Sprites stored in order of priority,
- * use the array indexes as a bucket to directly access the
- * x position as well as the next lower and higher priority sprite */
-static Node prio_sprites[MAX_SPRITES]; 
-static Node sentinal_deref;
-static Node *sentinal = &sentinal_deref; 
-static Node *head_ptr; //current head of queue
+/* Sprites are ordered by a packed 16 bit key, x position in the
+ * high byte and sprite number in the low byte, so ties in x position
+ * are broken by sprite number and every key is unique.
+ *
+ * Sprites which haven't had their x position written yet are
+ * given the keys 0xFF80 - 0xFFA7, these sort after every real key
+ * (the largest being 0xFF27) and keep their initial sprite number order.
+ * The sprite number can always be recovered with key & 0x7F */
+#define UNSET_KEY 0xFF80
+#define KEY_SPRITE_NO(k) ((k) & 0x7F)
+
+// Keys in order of priority, highest priority (lowest key) first
+static uint16_t prio_keys[MAX_SPRITES];
+// Current key of each sprite and its index in prio_keys
+static uint16_t sprite_keys[MAX_SPRITES];
+static uint8_t sprite_slots[MAX_SPRITES];
 
 void init_sprite_prio_list() {
 
-    Node *prev = sentinal;
     for (int i = 0; i < MAX_SPRITES; i++) {
-        Node *node = prio_sprites + i;
-        node->x_pos = 0xFFFF; //Lowest prio
-        node->next = (i >= MAX_SPRITES - 1) ? sentinal : prio_sprites + i + 1; 
-        node->prev = prev;
-        prev = &prio_sprites[i];
+        prio_keys[i] = UNSET_KEY | i;
+        sprite_keys[i] = UNSET_KEY | i;
+        sprite_slots[i] = i;
     }
-
-    sentinal->next = prio_sprites;
-    sentinal->prev = prio_sprites + MAX_SPRITES - 1;
-
-    head_ptr = sentinal->next;
-}
-
-
-static void move_after(Node *origin, Node *destination) {
-    // Relink either sides of node to move
-    origin->prev->next = origin->next;
-    origin->next->prev = origin->prev;
-
-    // Link the original node into new place
-    origin->prev = destination;
-    origin->next = destination->next;
-
-    //Connect new links back to origin
-    origin->next->prev = origin;
-    origin->prev->next = origin;
-
 }
 
 
 void update_sprite_prios(int sprite_no, uint8_t x_pos) {
-    
-    Node *current_node = prio_sprites + sprite_no;
+
     // Order by x position and if equal then by sprite number
     uint16_t val = (x_pos << 8) | sprite_no;
-    current_node->x_pos = val;
-    Node *swap_node = current_node;
-
-   
-    // Move up priorities
-    if (swap_node->prev != sentinal && val < swap_node->prev->x_pos) {
-        while (swap_node->prev != sentinal && val < swap_node->prev->x_pos) {
-            swap_node = swap_node->prev;
+    uint16_t old_val = sprite_keys[sprite_no];
+    int slot = sprite_slots[sprite_no];
+
+    /* Insertion sort step, shift neighbouring keys along until the
+     * new key is in order. Sprites usually only move a few pixels at a time
+     * so this rarely has to touch more than one or two keys */
+    if (val < old_val) { // Move up priorities
+        while (slot > 0 && prio_keys[slot - 1] > val) {
+            uint16_t key = prio_keys[slot - 1];
+            prio_keys[slot] = key;
+            sprite_slots[KEY_SPRITE_NO(key)] = slot;
+            slot--;
         }
-        move_after(current_node, swap_node->prev);
-     }
-    
-    // Move down priorites
-    else if (swap_node->next != sentinal && val > swap_node->next->x_pos) {
-        while (swap_node->next != sentinal && val > swap_node->next->x_pos) {
-            swap_node = swap_node->next;
+    } else { // Move down priorities
+        while (slot < MAX_SPRITES - 1 && prio_keys[slot + 1] < val) {
+            uint16_t key = prio_keys[slot + 1];
+            prio_keys[slot] = key;
+            sprite_slots[KEY_SPRITE_NO(key)] = slot;
+            slot++;
         }
-        move_after(current_node, swap_node);
     }
 
-    // Set new head if replaced
-    if (current_node != swap_node && swap_node == head_ptr) {
-        head_ptr = current_node;
+    prio_keys[slot] = val;
+    sprite_keys[sprite_no] = val;
+    sprite_slots[sprite_no] = slot;
+}
+
+
+void get_sprite_prio_order(uint8_t order[MAX_SPRITES]) {
+
+    for (int i = 0; i < MAX_SPRITES; i++) {
+        order[i] = KEY_SPRITE_NO(prio_keys[i]);
     }
 }
 
 
 Sprite_Iterator create_sprite_iterator() {
 	Sprite_Iterator si;
-	si.next = head_ptr;
+	si.next = 0;
     return si;
  }
 
 
 int sprite_iterator_next(Sprite_Iterator *si) {
-    
-    if (si->next != sentinal) {
-        int result = si->next - prio_sprites;
-        si->next = si->next->next;
-        return result;
+
+    if (si->next < MAX_SPRITES) {
+        return KEY_SPRITE_NO(prio_keys[si->next++]);
     } else {
         return -1;
     }
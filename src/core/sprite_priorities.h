@@ -5,19 +5,20 @@
 
 #define MAX_SPRITES 40
 
-typedef struct node Node;
-
 typedef struct sprite_iterator {
-    Node *next;
+    int next; // Index into the sorted priority table
 } Sprite_Iterator;
 
 void init_sprite_prio_list();
 
 /* Given the sprite number and its new starting x position
- * reorders the given sprite's priority */   
+ * reorders the given sprite's priority */
 void update_sprite_prios(int sprite_no, uint8_t x_pos);
 
+/* Copy the sprite numbers in order of priority,
+ * highest priority first, into the given array */
+void get_sprite_prio_order(uint8_t order[MAX_SPRITES]);
+
 Sprite_Iterator create_sprite_iterator();
 int sprite_iterator_next(Sprite_Iterator *si);
 #endif //SPRITE_PRIOS_H
-
@@ -0,0 +1,206 @@
+#ifndef VIDEO_CAPTURE
+#define VIDEO_CAPTURE
+#endif
+#include "../capture.c"
+#include "minunit/minunit.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PIXELS (CAPTURE_WIDTH * CAPTURE_HEIGHT)
+#define VIDEO_PATH "capture_tests_video.tmp"
+#define AUDIO_PATH "capture_tests_audio.tmp"
+#define SAMPLE_RATE 44100
+
+static uint32_t frames[3][PIXELS];
+static uint32_t decoded[PIXELS];
+static uint8_t buffer[DELTA_RLE_MAX_SIZE];
+
+void log_message(LogLevel ll, const char *fmt, ...) {
+    (void)ll;
+    (void)fmt;
+}
+
+
+static uint32_t read_u32(uint8_t const *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Apply an encoded frame to the previous frame in pixels
+ * returns the number of bytes read, 0 if invalid */
+static unsigned long decode_delta_rle(uint8_t const *src, unsigned long size, uint32_t *pixels) {
+    unsigned long pos = 0;
+    int i = 0;
+    while (i < PIXELS) {
+        if (pos + 4 > size) {
+            return 0;
+        }
+        int unchanged = src[pos] | (src[pos + 1] << 8);
+        int changed = src[pos + 2] | (src[pos + 3] << 8);
+        pos += 4;
+        i += unchanged;
+        if (i + changed > PIXELS || pos + (changed * 4) > size) {
+            return 0;
+        }
+        for (int j = 0; j < changed; j++, i++, pos += 4) {
+            pixels[i] ^= read_u32(&src[pos]);
+        }
+    }
+    return pos;
+}
+
+static long file_size(char const *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+
+void setup() {
+    for (int i = 0; i < PIXELS; i++) {
+        frames[0][i] = 0xFF000000 | (i * 0x010203);
+        frames[1][i] = frames[0][i];
+        frames[2][i] = 0xFF112233;
+    }
+    // A few scattered changes, including the first and last pixels
+    frames[1][0] = 0xFFFFFFFF;
+    frames[1][1000] = 0;
+    frames[1][1001] = 0x123456;
+    frames[1][PIXELS - 1] = 0xFF00FF00;
+}
+
+void teardown() {
+    remove(VIDEO_PATH);
+    remove(AUDIO_PATH);
+}
+
+
+MU_TEST(delta_rle_round_trip) {
+    memset(decoded, 0, sizeof(decoded));
+    uint32_t const *previous = decoded;
+    static uint32_t zero[PIXELS];
+
+    for (int f = 0; f < 3; f++) {
+        unsigned long size = encode_delta_rle(frames[f], f == 0 ? zero : frames[f - 1], buffer);
+        mu_check(size <= DELTA_RLE_MAX_SIZE);
+        mu_assert_int_eq(size, decode_delta_rle(buffer, size, decoded));
+        mu_check(memcmp(previous, frames[f], sizeof(decoded)) == 0);
+    }
+}
+
+MU_TEST(delta_rle_unchanged) {
+    // A long unchanged run is split into runs of at most DELTA_RLE_MAX_RUN
+    unsigned long size = encode_delta_rle(frames[0], frames[0], buffer);
+    mu_assert_int_eq(4 * ((PIXELS + DELTA_RLE_MAX_RUN - 1) / DELTA_RLE_MAX_RUN), size);
+
+    size = encode_delta_rle(frames[1], frames[0], buffer);
+    mu_assert_int_eq((3 * 4) + (4 * 4), size);
+}
+
+// Missing frame numbers are filled in by repeating the frame before
+MU_TEST(raw_fills_gaps) {
+    mu_check(start_capture(VIDEO_PATH, CAPTURE_RAW, NULL, SAMPLE_RATE));
+    capture_frame(frames[0], 10);
+    capture_frame(frames[1], 11);
+    capture_frame(frames[2], 14);
+    stop_capture();
+
+    mu_assert_int_eq(5 * PIXELS * 3, file_size(VIDEO_PATH));
+
+    FILE *f = fopen(VIDEO_PATH, "rb");
+    uint8_t rgb[3];
+    fseek(f, (3 * PIXELS * 3), SEEK_SET); // First pixel of the second repeat
+    mu_assert_int_eq(3, fread(rgb, 1, 3, f));
+    fclose(f);
+    mu_assert_int_eq(0xFF, rgb[0]);
+    mu_assert_int_eq(0xFF, rgb[1]);
+    mu_assert_int_eq(0xFF, rgb[2]);
+}
+
+MU_TEST(delta_rle_file) {
+    mu_check(start_capture(VIDEO_PATH, CAPTURE_DELTA_RLE, NULL, SAMPLE_RATE));
+    for (int i = 0; i < 3; i++) {
+        capture_frame(frames[i], i + 1);
+    }
+    stop_capture();
+
+    FILE *f = fopen(VIDEO_PATH, "rb");
+    uint8_t header[16];
+    mu_assert_int_eq(16, fread(header, 1, 16, f));
+    mu_check(memcmp(header, DELTA_RLE_MAGIC, 4) == 0);
+    mu_assert_int_eq(CAPTURE_FPS_NUM, read_u32(&header[8]));
+
+    memset(decoded, 0, sizeof(decoded));
+    for (int i = 0; i < 3; i++) {
+        uint8_t size_bytes[4];
+        mu_assert_int_eq(4, fread(size_bytes, 1, 4, f));
+        uint32_t size = read_u32(size_bytes);
+        mu_assert_int_eq(size, fread(buffer, 1, size, f));
+        mu_assert_int_eq(size, decode_delta_rle(buffer, size, decoded));
+        mu_check(memcmp(decoded, frames[i], sizeof(decoded)) == 0);
+    }
+    fclose(f);
+}
+
+MU_TEST(y4m_header) {
+    mu_check(start_capture(VIDEO_PATH, CAPTURE_Y4M, NULL, SAMPLE_RATE));
+    capture_frame(frames[2], 1);
+    stop_capture();
+
+    char const *header = "YUV4MPEG2 W160 H144 F4194304:70224 Ip A1:1 C444\n";
+    mu_assert_int_eq(strlen(header) + 6 + (PIXELS * 3), file_size(VIDEO_PATH));
+}
+
+/* Audio is padded with silence to the length of the video, which
+ * includes any frames dropped because the ring was full */
+MU_TEST(wav_matches_video) {
+    int16_t samples[200];
+    for (int i = 0; i < 200; i++) {
+        samples[i] = i;
+    }
+
+    mu_check(start_capture(VIDEO_PATH, CAPTURE_RAW, AUDIO_PATH, SAMPLE_RATE));
+    capture_audio(samples, 100);
+    for (int i = 0; i < 60; i++) {
+        capture_frame(frames[0], i);
+    }
+    stop_capture();
+
+    long expected = (60L * SAMPLE_RATE * CAPTURE_FPS_DEN) / CAPTURE_FPS_NUM;
+    mu_assert_int_eq(44 + (expected * 4), file_size(AUDIO_PATH));
+
+    FILE *f = fopen(AUDIO_PATH, "rb");
+    uint8_t header[44];
+    mu_assert_int_eq(44, fread(header, 1, 44, f));
+    int16_t first[2];
+    mu_assert_int_eq(2, fread(first, sizeof(int16_t), 2, f));
+    fclose(f);
+    mu_check(memcmp(header, "RIFF", 4) == 0);
+    mu_assert_int_eq(expected * 4, read_u32(&header[40]));
+    mu_assert_int_eq(0, first[0]);
+    mu_assert_int_eq(1, first[1]);
+}
+
+
+MU_TEST_SUITE(capture) {
+
+	MU_SUITE_CONFIGURE(&setup, &teardown)
+    ;
+    MU_RUN_TEST(delta_rle_round_trip);
+    MU_RUN_TEST(delta_rle_unchanged);
+    MU_RUN_TEST(raw_fills_gaps);
+    MU_RUN_TEST(delta_rle_file);
+    MU_RUN_TEST(y4m_header);
+    MU_RUN_TEST(wav_matches_video);
+}
+
+
+int main() {
+    MU_RUN_SUITE(capture);
+    MU_REPORT();
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "../mmu/mbc3.c"
+#include "minunit/minunit.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DAY (24 * 60 * 60)
+
+uint8_t *RAM_banks;
+uint8_t *ROM_banks;
+unsigned RAM_bank_count = 0;
+uint8_t *RTC_save;
+
+static uint8_t save[RTC_SAVE_SIZE];
+static uint8_t file[RTC_SAVE_SIZE];
+static uint64_t host_time = 0;
+static int saves = 0;
+
+uint64_t get_time() {
+    return host_time * 1000;
+}
+
+void write_SRAM() {
+    memcpy(file, save, RTC_SAVE_SIZE);
+    saves++;
+}
+
+void read_SRAM() {
+    memcpy(save, file, RTC_SAVE_SIZE);
+}
+
+
+static void latch() {
+    write_MBC3(0x6000, 0);
+    write_MBC3(0x6000, 1);
+}
+
+static uint8_t read_reg(uint8_t reg) {
+    write_MBC3(0x4000, reg);
+    return read_MBC3(0xA000);
+}
+
+static void write_reg(uint8_t reg, uint8_t val) {
+    write_MBC3(0x4000, reg);
+    write_MBC3(0xA000, val);
+}
+
+// Start the cartridge again as if the emulator was restarted
+static void restart() {
+    write_MBC3(0x0000, 0);
+    RTC_save = save;
+    latch_regs = (rtc_regs_MBC3){0};
+    setup_MBC3(RTC | BATTERY);
+    write_MBC3(0x0000, 0xA);
+}
+
+
+void setup() {
+    memset(file, 0, sizeof(file));
+    host_time = 1000000;
+    saves = 0;
+    rtc_flags = 0;
+    latch_regs = (rtc_regs_MBC3){0};
+    RTC_save = save;
+    setup_MBC3(RTC | BATTERY);
+    write_MBC3(0x0000, 0xA);
+}
+
+void teardown() {
+}
+
+
+// Registers only change when latched
+MU_TEST(latch_host_time) {
+    host_time += (2 * DAY) + (3 * 60 * 60) + (4 * 60) + 5;
+    mu_assert_int_eq(0, read_reg(0x8));
+    latch();
+    mu_assert_int_eq(5, read_reg(0x8));
+    mu_assert_int_eq(4, read_reg(0x9));
+    mu_assert_int_eq(3, read_reg(0xA));
+    mu_assert_int_eq(2, read_reg(0xB));
+    mu_assert_int_eq(0, read_reg(0xC));
+}
+
+MU_TEST(write_registers) {
+    write_reg(0xA, 23);
+    write_reg(0x9, 59);
+    write_reg(0x8, 59);
+    host_time += 1;
+    latch();
+    mu_assert_int_eq(0, read_reg(0x8));
+    mu_assert_int_eq(0, read_reg(0x9));
+    mu_assert_int_eq(0, read_reg(0xA));
+    mu_assert_int_eq(1, read_reg(0xB));
+}
+
+MU_TEST(halt) {
+    host_time += 10;
+    write_reg(0xC, BIT_6);
+    host_time += 100;
+    latch();
+    mu_assert_int_eq(10, read_reg(0x8));
+    mu_assert_int_eq(BIT_6, read_reg(0xC));
+
+    write_reg(0xC, 0);
+    host_time += 5;
+    latch();
+    mu_assert_int_eq(15, read_reg(0x8));
+}
+
+// The 9 bit day counter wraps and sets the carry bit until cleared
+MU_TEST(day_carry) {
+    host_time += (511 * DAY);
+    latch();
+    mu_assert_int_eq(0xFF, read_reg(0xB));
+    mu_assert_int_eq(1, read_reg(0xC));
+
+    host_time += DAY + 1;
+    latch();
+    mu_assert_int_eq(1, read_reg(0x8));
+    mu_assert_int_eq(0, read_reg(0xB));
+    mu_assert_int_eq(BIT_7, read_reg(0xC));
+
+    write_reg(0xC, 0);
+    latch();
+    mu_assert_int_eq(0, read_reg(0xC));
+}
+
+// Time passed while not running is added when loaded
+MU_TEST(saved_clock) {
+    host_time += 30;
+    write_reg(0x9, 20);
+    write_MBC3(0x0000, 0);
+    mu_assert_int_eq(1, saves);
+
+    host_time += DAY + 10;
+    restart();
+    latch();
+    mu_assert_int_eq(40, read_reg(0x8));
+    mu_assert_int_eq(20, read_reg(0x9));
+    mu_assert_int_eq(1, read_reg(0xB));
+}
+
+// A halted clock doesn't count the time while not running
+MU_TEST(saved_halted_clock) {
+    host_time += 30;
+    write_reg(0xC, BIT_6);
+    write_MBC3(0x0000, 0);
+
+    host_time += DAY;
+    restart();
+    latch();
+    mu_assert_int_eq(30, read_reg(0x8));
+    mu_assert_int_eq(0, read_reg(0xB));
+    mu_assert_int_eq(BIT_6, read_reg(0xC));
+}
+
+
+MU_TEST_SUITE(rtc) {
+
+	MU_SUITE_CONFIGURE(&setup, &teardown)
+    ;
+    MU_RUN_TEST(latch_host_time);
+    MU_RUN_TEST(write_registers);
+    MU_RUN_TEST(halt);
+    MU_RUN_TEST(day_carry);
+    MU_RUN_TEST(saved_clock);
+    MU_RUN_TEST(saved_halted_clock);
+}
+
+
+int main() {
+    MU_RUN_SUITE(rtc);
+    MU_REPORT();
+    return 0;
+}
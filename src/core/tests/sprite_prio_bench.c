@@ -0,0 +1,81 @@
+#include "../sprite_priorities.c"
+#include <stdio.h>
+#include <time.h>
+
+/* Benchmarks sprite priority updates for OAM write patterns
+ * seen in games, as well as iterating the priority list
+ * once per scanline */
+
+#define FRAMES 200000
+
+static volatile int sink;
+
+static void iterate_lines(int lines) {
+    for (int l = 0; l < lines; l++) {
+        Sprite_Iterator si = create_sprite_iterator();
+        int sprite_no;
+        while ((sprite_no = sprite_iterator_next(&si)) != -1) {
+            sink += sprite_no;
+        }
+    }
+}
+
+// Every sprite rewritten each frame, as an OAM DMA routine copying
+// a shadow OAM does, with all sprites moving right by 1
+static void pattern_full_rewrite(int frame) {
+    for (int i = 0; i < MAX_SPRITES; i++) {
+        update_sprite_prios(i, (uint8_t)(i * 4 + frame));
+    }
+}
+
+// Sprites scattered across the screen, shuffled every frame
+static void pattern_shuffle(int frame) {
+    uint32_t seed = frame * 2654435761u;
+    for (int i = 0; i < MAX_SPRITES; i++) {
+        seed = seed * 1103515245u + 12345u;
+        update_sprite_prios(i, (uint8_t)(seed >> 16));
+    }
+}
+
+// A single metasprite (4 sprites wide) moving back and forth
+static void pattern_metasprite(int frame) {
+    uint8_t x = (uint8_t)((frame % 128) < 64 ? frame % 64 : 64 - (frame % 64));
+    for (int i = 0; i < 4; i++) {
+        update_sprite_prios(i, x + i * 8);
+    }
+}
+
+// Sprites crossing each other in opposite directions, maximising
+// how far each sprite has to move in the priority order
+static void pattern_crossing(int frame) {
+    for (int i = 0; i < MAX_SPRITES; i++) {
+        uint8_t x = (i & 1) ? (uint8_t)(frame + i) : (uint8_t)(168 - frame - i);
+        update_sprite_prios(i, x);
+    }
+}
+
+static void run_pattern(const char *name, void (*pattern)(int), int updates_per_frame) {
+    init_sprite_prio_list();
+
+    clock_t start = clock();
+    for (int f = 0; f < FRAMES; f++) {
+        pattern(f);
+    }
+    double update_secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    iterate_lines(FRAMES);
+    double iterate_secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%-16s %8.2f ns/update %8.2f ns/iteration\n", name,
+        (update_secs * 1e9) / ((double)FRAMES * updates_per_frame),
+        (iterate_secs * 1e9) / FRAMES);
+}
+
+int main() {
+    run_pattern("full_rewrite", pattern_full_rewrite, MAX_SPRITES);
+    run_pattern("shuffle", pattern_shuffle, MAX_SPRITES);
+    run_pattern("metasprite", pattern_metasprite, 4);
+    run_pattern("crossing", pattern_crossing, MAX_SPRITES);
+    return 0;
+}
@@ -1,18 +1,26 @@
 #include "timers.h"
 #include "interrupts.h"
 #include "bits.h"
-#include "mmu/mbc.h"
 
 //Possible timer increment timer_frequencies in hz
 #define TIMER_FREQUENCIES_LEN sizeof (timer_frequencies) / sizeof (long)
-static const long timer_frequencies[] = {1024, 16, 64, 256}; 
+static const long timer_frequencies[] = {1024, 16, 64, 256};
 
 static long timer_frequency = -1;
 static long timer_counter = 0;
-static uint64_t clocks = 0;
+static long divider_counter = 0;
+
+/* DIV and TIMA are only brought up to date when read, written or when
+ * TIMA next overflows, from the cycles passed since they were last
+ * updated. Nothing else happens until master_cycles reaches
+ * next_timer_event */
+static uint64_t master_cycles = 0;
+static uint64_t div_updated = 0; // master_cycles DIV was last updated at
+static uint64_t tima_updated = 0;
+static uint64_t next_timer_event = 0;
 
 /* Change the timer frequency to another of the possible
- * frequencies, resets the timer_counter 
+ * frequencies, resets the timer_counter
  * If frequency number selected isn't valid then nothing happens*/
 void set_timer_frequency(unsigned int n) {
     if (n < TIMER_FREQUENCIES_LEN) {
@@ -35,11 +43,11 @@ void increment_tima() {
         raise_interrupt(TIMER_INT);
     }
     io_mem[TIMA_REG] = tima;
-    
+
 }
 
 
-/*  Increment DIV register 
+/*  Increment DIV register
  *  should be incremented at a frequency of 16382
  *  (once every 256 clock cycles)*/
 void increment_div() {
@@ -47,45 +55,99 @@ void increment_div() {
 }
 
 
-void update_divider_reg(long cycles) {
-    
-    static long divider_counter = 0;
+static void update_divider_reg() {
 
-	divider_counter += cycles;
-	long div_cycles = cgb_speed ? 128 : 256;
-	while (divider_counter >= div_cycles) {
-		increment_div();
-		divider_counter -= div_cycles;
-	}
+    divider_counter += master_cycles - div_updated;
+    div_updated = master_cycles;
+
+    long div_cycles = cgb_speed ? 128 : 256;
+    io_mem[DIV_REG] += divider_counter / div_cycles;
+    divider_counter %= div_cycles;
 }
 
+// Add the given number of increments to TIMA
+static void add_tima(long increments) {
 
-/* Update internal timers given the cycles executed since
-* the last time this function was called. */
-void update_timers(long cycles) {
-    clocks += cycles;
-    // Inc MBC3 RTC seconds
-    if (clocks >= 4 * 1024 * 1024) {
-        inc_sec_mbc3();         
-        clocks -= 4 * 1024 * 1024;
+    long tima = io_mem[TIMA_REG];
+    if (tima + increments < 0x100) {
+        io_mem[TIMA_REG] = tima + increments;
+        return;
     }
 
-	uint8_t timer_control = io_mem[TAC_REG];
+    // Reloaded from TMA every overflow
+    increments -= 0x100 - tima;
+    long period = 0x100 - io_mem[TMA_REG];
+    io_mem[TIMA_REG] = io_mem[TMA_REG] + (increments % period);
+    raise_interrupt(TIMER_INT);
+}
+
+static void update_tima() {
+
+    long cycles = master_cycles - tima_updated;
+    tima_updated = master_cycles;
 
-	update_divider_reg(cycles);
+	uint8_t timer_control = io_mem[TAC_REG];
 	//Clock enabled
 	if ((timer_control & BIT_2) != 0) {
 		if (timer_frequency == -1) { // If timer not set
 			set_timer_frequency(timer_control & 3);
 		}
 		timer_counter += cycles;
-		/* Once timer incremented, check for changes in timer frequency,
-		* and reset timer */
-		while (timer_counter >= get_timer_frequency()) {
+		/* The first increment is at the frequency the timer was running
+		 * at, the frequency is then changed to the one in TAC */
+		if (timer_counter >= get_timer_frequency()) {
 			timer_counter -= get_timer_frequency();
-			increment_tima();
 			set_timer_frequency(timer_control & 3);
+			long increments = 1 + (timer_counter / get_timer_frequency());
+			timer_counter %= get_timer_frequency();
+			add_tima(increments);
 		}
 	}
 }
 
+// Work out when TIMA next overflows
+static void schedule_timer_event() {
+
+    next_timer_event = UINT64_MAX;
+
+    uint8_t timer_control = io_mem[TAC_REG];
+    if ((timer_control & BIT_2) != 0) {
+        if (timer_frequency == -1) {
+            set_timer_frequency(timer_control & 3);
+        }
+        long first = get_timer_frequency() - timer_counter;
+        long period = (cgb_speed ? timer_frequencies[timer_control & 3] / 2 : timer_frequencies[timer_control & 3]);
+        next_timer_event = master_cycles + first + ((0xFF - io_mem[TIMA_REG]) * period);
+    }
+}
+
+void sync_timers() {
+    update_divider_reg();
+    update_tima();
+    schedule_timer_event();
+}
+
+void set_divider(uint16_t counter) {
+    sync_timers();
+    long div_cycles = cgb_speed ? 128 : 256;
+    io_mem[DIV_REG] = counter >> 8;
+    divider_counter = (counter & 0xFF) % div_cycles;
+}
+
+void timer_reg_written(uint8_t addr, uint8_t val) {
+    sync_timers();
+    /*  Attempting to set DIV reg resets it to 0 */
+    io_mem[addr] = addr == DIV_REG ? 0 : val;
+    schedule_timer_event();
+}
+
+/* Update internal timers given the cycles executed since
+* the last time this function was called. */
+void update_timers(long cycles) {
+    master_cycles += cycles;
+    if (master_cycles < next_timer_event) {
+        return;
+    }
+    update_tima();
+    schedule_timer_event();
+}
@@ -33,4 +33,15 @@ void set_timer_frequency(unsigned int n);
 * the last time this function was called. */
 void update_timers(long cycles);
 
+/* Bring DIV and TIMA up to date, should be called before they
+ * are read or the clock speed changes */
+void sync_timers();
+
+/* Set the internal counter DIV is the upper 8 bits of,
+ * as it would be after the given number of cycles */
+void set_divider(uint16_t counter);
+
+// Write to DIV, TIMA, TMA or TAC given IO address 0 - 0xFF
+void timer_reg_written(uint8_t addr, uint8_t val);
+
 #endif //TIMERS_H
@@ -6,4 +6,7 @@
 // Returns time in miliseconds since Unix Epoch
 uint64_t get_time();
 
+// Returns time in microseconds from an arbitrary start, for timing intervals
+uint64_t get_time_micro();
+
 #endif
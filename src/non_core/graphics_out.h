@@ -14,5 +14,21 @@ int init_screen(int win_x, int win_y, uint32_t *pixels);
 /*  Update the screen output*/
 void draw_screen();
 
+/* Destination for rows of the screen to be written straight
+ * into, already scaled, instead of the buffer given to init_screen */
+typedef struct {
+    uint32_t *pixels; // Top left pixel of the screen
+    int stride; // Pixels per row
+    int scale; // Copies of each pixel horizontally and vertically, 1 - 8
+    int rgbx; // 1 if pixels are red, green, blue, reserved bytes rather than blue, green, red, reserved
+    int refresh_interval; // Frames between redrawing every row, 0 for never
+} Screen_Target;
+
+/* Obtain the platform's preferred destination for the screen,
+ * checked at the start of every frame.
+ * returns 1 if rows should be written to the target,
+ * 0 if the platform outputs the buffer given to init_screen itself */
+int get_screen_target(Screen_Target *target);
+
 
 #endif
@@ -17,6 +17,10 @@ void set_log_level(LogLevel ll);
  * will be successfully logged. */
 void log_message(LogLevel ll, const char *fmt, ...); 
 
+/* Write out any messages the logger is still holding
+ * on to, before exiting */
+void flush_log();
+
 #ifdef __cplusplus
 }
 #endif
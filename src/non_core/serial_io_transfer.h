@@ -6,3 +6,7 @@ int setup_server(unsigned port);
 
 uint8_t transfer_int(uint8_t data);
 int transfer_ext(uint8_t data, uint8_t *recv);
+
+/* Called regularly with the cycles run since last called, so links
+ * to another running Gameboy can keep both in step */
+void link_sync(unsigned long cycles);
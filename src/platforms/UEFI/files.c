@@ -27,8 +27,8 @@ unsigned long load_rom_from_file(const char *file_path, unsigned char *data) {
 
     uint32_t count = 0; 
     size_t read = 0; 
-    //Read file contents into buffer
-    while(count < MAX_FILE_SIZE && (read = uefi_fread(data, 1, 4096, file)) > 0) {
+    //Read file contents into buffer, as much as the file protocol gives at once
+    while(count < MAX_FILE_SIZE && (read = uefi_fread(data, 1, MAX_FILE_SIZE - count, file)) > 0) {
         count += read;
         data += read;
     }
@@ -1,4 +1,5 @@
 #include "../../non_core/logger.h"
+#include "../../non_core/get_time.h"
 
 #include <Uefi.h>
 #include <Library/UefiApplicationEntryPoint.h>
@@ -24,6 +25,19 @@ static EFI_FILE_PROTOCOL* root = NULL;
 static EFI_FILE_PROTOCOL* logfile = NULL;
 static CHAR16* logfile_path =  L"logfile.txt";
 
+/* Messages are held here and written together, when full, when an
+ * error is logged or by flush_log. The log file isn't created until
+ * the first write */
+#define LOG_BUFFER_SIZE 4096
+static char log_buffer[LOG_BUFFER_SIZE];
+static UINTN log_buffered = 0;
+
+// The RTC is slow to read, messages soon after the last read reuse its time
+#define LOG_TIME_REUSE_US 10000
+static char time_str[32];
+static UINTN time_len = 0;
+static uint64_t time_read_at = 0;
+
 void set_log_level(LogLevel ll) {
     
     if (ll >= LOG_OFF) {
@@ -98,15 +112,29 @@ static unsigned uint_to_hex_str(unsigned i, char *buf, int uppercase) {
      return digits;
 }
 
-//Logs the current time to the given stream
+static void buffer_log(const char *data, UINTN len) {
+    if (log_buffered + len > LOG_BUFFER_SIZE) {
+        flush_log();
+    }
+    memcpy(log_buffer + log_buffered, data, len);
+    log_buffered += len;
+}
+
+//Logs the current time
 static void log_time() {
     
-    char buf[100];
+    uint64_t now = get_time_micro();
+    if (time_len > 0 && now - time_read_at < LOG_TIME_REUSE_US) {
+        buffer_log(time_str, time_len);
+        return;
+    }
+
     EFI_TIME    Time;
 
     gRT->GetTime (&Time, NULL);
+    time_read_at = now;
 
-    char *buf_ptr = buf;
+    char *buf_ptr = time_str;
     
     buf_ptr += uint_to_str_padded(Time.Year, buf_ptr, 4);
     *buf_ptr = '-';
@@ -131,11 +159,9 @@ static void log_time() {
     buf_ptr += uint_to_str_padded(Time.Second, buf_ptr, 2);
     *buf_ptr = ' ';
     buf_ptr++;
-    *buf_ptr = '\0';
     
-    UINTN bufSize = strlen(buf);
-    offset += bufSize;
-    logfile->Write(logfile, &bufSize, (CHAR16 *)buf);
+    time_len = buf_ptr - time_str;
+    buffer_log(time_str, time_len);
 }       
 /*    
     char buffer[30];
@@ -207,6 +233,34 @@ void init_logfile() {
     init = 1;
 }
 
+void flush_log() {
+
+    if (log_buffered == 0) {
+        return;
+    }
+    if (!init) {
+        init_logfile();
+    }
+
+    // Can't do anything, just drop the messages
+    if (root == NULL || EFI_ERROR(root->Open(
+            root, 
+            &logfile,
+            logfile_path,
+            EFI_FILE_MODE_WRITE | EFI_FILE_MODE_READ,
+            0))) {
+        log_buffered = 0;
+        return;    
+    }
+
+    logfile->SetPosition(logfile, offset);
+    UINTN len = log_buffered;
+    logfile->Write(logfile, &len, (CHAR16 *)log_buffer);
+    offset += log_buffered;
+    logfile->Close(logfile);
+    log_buffered = 0;
+}
+
 
 	
 void log_message(LogLevel ll, const char *fmt, ...) {
@@ -214,9 +268,6 @@ void log_message(LogLevel ll, const char *fmt, ...) {
        
     if(ll <= LOG_OFF && ll >= current_log_level) {
     
-        if (!init) {
-            init_logfile();
-        }
         // Choose output stream based on current log level
 
         //FILE *stream = (ll == LOG_INFO) ? stdout : stderr;
@@ -230,24 +281,8 @@ void log_message(LogLevel ll, const char *fmt, ...) {
             default : level_str = "[UNKNOWN] "; // Shouldn't happen 
         }
         
-        EFI_STATUS efiStatus = root->Open(
-            root, 
-            &logfile,
-            logfile_path,
-            EFI_FILE_MODE_WRITE | EFI_FILE_MODE_READ,
-            0);
-    
-        // Can't do anything, just drop out
-        if (EFI_ERROR(efiStatus)) {
-            return;    
-        }
-        
-        logfile->SetPosition(logfile, offset);
-   
         log_time();
-        UINTN level_len = strlen(level_str);
-        logfile->Write(logfile, &level_len, (CHAR16 *)level_str); 
-        offset += level_len;
+        buffer_log(level_str, strlen(level_str));
     
         // Log message
         va_list args;
@@ -323,9 +358,11 @@ void log_message(LogLevel ll, const char *fmt, ...) {
 
         va_end(args);        
         
-        offset += buffer_index;
-    
-        efiStatus = logfile->Write(logfile, (UINTN *)(&buffer_index), (CHAR16 *)buffer);
-        logfile->Close(logfile); 
+        buffer_log(buffer, buffer_index);
+
+        // Keep errors even if nothing else gets written
+        if (ll == LOG_ERROR) {
+            flush_log();
+        }
     } 
 }
@@ -5,6 +5,7 @@
 #include <Uefi.h>
 #include <Library/UefiApplicationEntryPoint.h>
 #include <Library/UefiLib.h>
+#include <Library/BaseLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/DebugLib.h>
 #include <Library/PrintLib.h>
@@ -88,42 +89,50 @@ PlutoboyMain (
     	}
 	}
 
-	if (argc < 2) {
-		Print(L"Usage: plutoboy.efi rom\n");
+    int debug = 0;
+    int dmg_mode = 0;
+    int skip_boot = 0;
+	CHAR16 *rom_arg = NULL;
+
+	// Options can come before or after the ROM
+	for (int i = 1; i < argc; i++) {
+		if (StrCmp(argv[i], L"-skipboot") == 0) {
+			skip_boot = 1;
+		} else if (rom_arg == NULL) {
+			rom_arg = argv[i];
+		}
+	}
+
+	if (rom_arg == NULL) {
+		Print(L"Usage: plutoboy.efi [-skipboot] rom\n");
 		return 1;
 	}
 
-	char *file_name = malloc(StrLen(argv[1]) + 1);
+	char *file_name = malloc(StrLen(rom_arg) + 1);
 	if (file_name == NULL) {
 		return 1;
 	}
 	
-	for (int i = 0; i < StrLen(argv[1]) * 2; i++) {
-		file_name[i] = (char)(argv[1][i]);
+	for (int i = 0; i < StrLen(rom_arg); i++) {
+		file_name[i] = (char)(rom_arg[i]);
 	}
 
-	file_name[StrLen(argv[1])] = '\0';
- 
-    int debug = 0;
-    int dmg_mode = 0;
+	file_name[StrLen(rom_arg)] = '\0';
 		
     set_log_level(LOG_INFO);
-	log_message(LOG_INFO, "Test log %d\n", 27);
-	log_message(LOG_ERROR, "Test log hex 0x%x\n", 0x10);
-	log_message(LOG_WARN, "Test log HEX 0x%X\n", 0x10);
-	log_message(LOG_INFO, "About to open file %s\n", "rom.gb");
 
     ClientOrServer cs = NO_CONNECT;
     
-    if (!init_emu(file_name, debug, dmg_mode, cs)) {
+    if (!init_emu(file_name, debug, dmg_mode, skip_boot, cs)) {
         Print(L"Failed to init emulator\n");
 		log_message(LOG_ERROR, "failed to load file\n");
         free(file_name);
 		return 1;
     }
-    log_message(LOG_INFO, "exiting\n");
 	
     run();
+    log_message(LOG_INFO, "exiting\n");
+    flush_log();
     free(file_name);
 	return EFI_SUCCESS;
 }
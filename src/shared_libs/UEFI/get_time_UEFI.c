@@ -0,0 +1,18 @@
+#include "../../non_core/get_time.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#include <Uefi.h>
+#include <Library/TimerLib.h>
+
+
+// Returns time in miliseconds since Unix Epoch
+uint64_t get_time() {
+    return (uint64_t)time(NULL) * 1000;
+}
+
+// Returns time in microseconds from an arbitrary start, for timing intervals
+uint64_t get_time_micro() {
+    return GetTimeInNanoSecond(GetPerformanceCounter()) / 1000;
+}
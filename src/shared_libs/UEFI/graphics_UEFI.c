@@ -1,4 +1,6 @@
 #include "../../non_core/graphics_out.h"
+#include "../scaler.h"
+#include "../dirty_rects.h"
 
 #include <Uefi.h>
 #include <Library/UefiApplicationEntryPoint.h>
@@ -15,10 +17,20 @@
 #define GB_RES_X 160
 #define GB_RES_Y 144
 
+// Frames between full refreshes, in case anything else draws over the screen
+#define DIRTY_REFRESH_INTERVAL 300
+
 static EFI_GRAPHICS_OUTPUT_BLT_PIXEL *pixels;
 static EFI_GRAPHICS_OUTPUT_BLT_PIXEL *old_pixels; // Current screen before running the emulator
 static EFI_GRAPHICS_OUTPUT_PROTOCOL  *GraphicsOutput = NULL;
 static EFI_GRAPHICS_OUTPUT_BLT_PIXEL *output_pixels = NULL;
+static UINTN output_pixels_size = 0;
+
+/* Linear frame buffer, only used if its pixel format can be written to
+ * directly, otherwise the scaled screen is output with Blt */
+static uint32_t *frame_buffer = NULL;
+static UINTN frame_buffer_stride = 0; // Pixels per scan line
+static Scale_Format frame_buffer_format = SCALE_BGRX;
 static int screen_width = 0;
 static int screen_height = 0;
 
@@ -26,6 +38,7 @@ extern int scale;
 extern int full_size;
 
 static int current_scale = 1;
+static Dirty_Tracker dirty_tracker;
 static int x_res = 0;
 static int y_res = 0;
 
@@ -42,6 +55,7 @@ int init_screen(int win_x, int win_y, uint32_t *p) {
     screen_height = win_y;
 
     pixels = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)p;
+    init_dirty_tracker(&dirty_tracker, DIRTY_REFRESH_INTERVAL);
 
    // Locate all instances of GOP
    EFI_STATUS Status = gBS->LocateHandleBuffer(ByProtocol
@@ -82,6 +96,15 @@ int init_screen(int win_x, int win_y, uint32_t *p) {
             x_res = info->HorizontalResolution;
             y_res = info->VerticalResolution;
 
+            if (GraphicsOutput->Mode->FrameBufferBase != 0 &&
+               (info->PixelFormat == PixelBlueGreenRedReserved8BitPerColor ||
+                info->PixelFormat == PixelRedGreenBlueReserved8BitPerColor)) {
+                frame_buffer = (uint32_t *)(UINTN)GraphicsOutput->Mode->FrameBufferBase;
+                frame_buffer_stride = info->PixelsPerScanLine;
+                frame_buffer_format = info->PixelFormat == PixelRedGreenBlueReserved8BitPerColor ?
+                    SCALE_RGBX : SCALE_BGRX;
+            }
+
             old_pixels = malloc(x_res * y_res * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
             if (old_pixels != NULL) {
 		        GraphicsOutput->Blt(GraphicsOutput, old_pixels, EfiBltVideoToBltBuffer, 0, 0, 0, 0, x_res, y_res, 0); 
@@ -96,49 +119,94 @@ int init_screen(int win_x, int win_y, uint32_t *p) {
     return 0; // Failed
 }
 
-void draw_screen() {
-        
-        if (scale != current_scale) {
-            // If resolution is too big/too small
-            if (scale < 1 || (GB_RES_X * scale > x_res) || GB_RES_Y * scale > y_res) {
-                scale = current_scale;
-            } else {
-                if (old_pixels != NULL) {
-		            GraphicsOutput->Blt(GraphicsOutput, old_pixels, EfiBltBufferToVideo, 0, 0, 0, 0, x_res, y_res, 0); 
-                }
+// Switch to a newly requested scale if it fits on screen
+static void update_scale() {
 
-                if (output_pixels != NULL) {
-                    free(output_pixels);
-                }
-                output_pixels = malloc(GB_RES_X * GB_RES_Y * scale * scale * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
-                current_scale = scale;
+    if (scale != current_scale) {
+        // If resolution is too big/too small
+        if (scale < 1 || scale > MAX_SCALE || (GB_RES_X * scale > x_res) || GB_RES_Y * scale > y_res) {
+            scale = current_scale;
+        } else {
+            if (old_pixels != NULL) {
+                GraphicsOutput->Blt(GraphicsOutput, old_pixels, EfiBltBufferToVideo, 0, 0, 0, 0, x_res, y_res, 0); 
             }
+            current_scale = scale;
+            force_full_refresh(&dirty_tracker);
         }
+    }
+}
 
-        UINTN x_offset = (x_res - (scale * GB_RES_X)) / 2;
-        UINTN y_offset = (y_res - (scale * GB_RES_Y)) / 2;
-      
-        if (current_scale <= 1) {
-		    GraphicsOutput->Blt(GraphicsOutput, pixels, EfiBltBufferToVideo, 0, 0, x_offset, y_offset, GB_RES_X, GB_RES_Y, 0); 
-        } else {
+/* The screen is rendered straight into the frame buffer
+ * if its pixel format can be written to directly */
+int get_screen_target(Screen_Target *target) {
 
-            uint32_t *frame_buffer = (uint32_t *)output_pixels;
-            
-            for (UINTN y_pix = 0; y_pix < GB_RES_Y; y_pix++) {
-                uint32_t *frame_buffer_row = ((uint32_t *)output_pixels) + (y_pix * current_scale * current_scale * GB_RES_X);
-                for (UINTN y_pix_scale = 0; y_pix_scale < current_scale; y_pix_scale++) {
-                    frame_buffer = frame_buffer_row + (GB_RES_X * scale * y_pix_scale);
-                    uint32_t *current_pix = ((uint32_t *)pixels) + (y_pix * GB_RES_X);
-                    for (UINTN x_pix = 0; x_pix < GB_RES_X; x_pix++, frame_buffer +=current_scale) {
-                        for (UINTN i = 0; i < current_scale; i++) {
-                            frame_buffer[i] = *(((int*)current_pix) + x_pix);
-                        }
-                    } 
+    update_scale();
+    if (frame_buffer == NULL) {
+        return 0;
+    }
+
+    UINTN x_offset = (x_res - (current_scale * GB_RES_X)) / 2;
+    UINTN y_offset = (y_res - (current_scale * GB_RES_Y)) / 2;
+
+    target->pixels = frame_buffer + (y_offset * frame_buffer_stride) + x_offset;
+    target->stride = frame_buffer_stride;
+    target->scale = current_scale;
+    target->rgbx = frame_buffer_format == SCALE_RGBX;
+    target->refresh_interval = DIRTY_REFRESH_INTERVAL;
+    return 1;
+}
+
+/* Output a changed region of the screen, scaling it first
+ * if the screen isn't being output at its original size */
+static void blit_rect(void *ctx, Dirty_Rect const *rect) {
+
+    UINTN x_offset = (x_res - (current_scale * GB_RES_X)) / 2;
+    UINTN y_offset = (y_res - (current_scale * GB_RES_Y)) / 2;
+    UINTN s = current_scale;
+
+    if (s <= 1) {
+        GraphicsOutput->Blt(GraphicsOutput, pixels, EfiBltBufferToVideo, rect->x, rect->y,
+                            x_offset + rect->x, y_offset + rect->y, rect->width, rect->height,
+                            GB_RES_X * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+        return;
+    }
+
+    // Blt buffers are always blue, green, red, reserved
+    uint32_t *dest = (uint32_t *)output_pixels + (rect->y * s * GB_RES_X * s) + (rect->x * s);
+    scale_pixels((uint32_t *)pixels + (rect->y * GB_RES_X) + rect->x, rect->width, rect->height, GB_RES_X,
+                 dest, GB_RES_X * s, s, SCALE_BGRX);
+
+    GraphicsOutput->Blt(GraphicsOutput, output_pixels, EfiBltBufferToVideo, rect->x * s, rect->y * s,
+                        x_offset + (rect->x * s), y_offset + (rect->y * s), rect->width * s, rect->height * s,
+                        GB_RES_X * s * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+}
+
+void draw_screen() {
+
+        // Already rendered straight into the frame buffer, unchanged rows are skipped while rendering
+        if (frame_buffer != NULL) {
+            return;
+        }
+
+        update_scale();
+
+        if (current_scale > 1) {
+            // The buffer is kept between frames and only grows
+            UINTN size = GB_RES_X * GB_RES_Y * current_scale * current_scale * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+            if (size > output_pixels_size) {
+                if (output_pixels != NULL) {
+                    free(output_pixels);
+                }
+                output_pixels = malloc(size);
+                output_pixels_size = output_pixels != NULL ? size : 0;
+                if (output_pixels == NULL) {
+                    return;
                 }
             }
-		    
-            GraphicsOutput->Blt(GraphicsOutput, output_pixels, EfiBltBufferToVideo, 0, 0, x_offset, y_offset, GB_RES_X * scale, GB_RES_Y * scale, 0); 
         }
+
+        // Only regions which have changed since the last frame are scaled and output
+        present_dirty_rects(&dirty_tracker, (uint32_t *)pixels, blit_rect, NULL);
 }
 
 void cleanup_graphics_out() {
@@ -38,3 +38,7 @@ int transfer_ext(uint8_t data, uint8_t *recv) {
 uint8_t transfer_int(uint8_t data) {
     return 0xFF;
 }
+
+
+void link_sync(unsigned long cycles) {
+}
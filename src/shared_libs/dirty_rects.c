@@ -0,0 +1,126 @@
+#include "dirty_rects.h"
+
+#include <string.h>
+
+#define TILE_ROW_BYTES (DIRTY_TILE_SIZE * sizeof(uint32_t))
+
+void init_dirty_tracker(Dirty_Tracker *dt, int refresh_interval) {
+    memset(dt->previous, 0, sizeof(dt->previous));
+    dt->refresh_interval = refresh_interval;
+    dt->frames_since_refresh = 0;
+    dt->refresh_pending = 1;
+}
+
+void force_full_refresh(Dirty_Tracker *dt) {
+    dt->refresh_pending = 1;
+}
+
+
+/* Find which tiles in the given row of tiles have changed since the
+ * last frame, changed tiles are copied so they're up to date next frame */
+static void find_dirty_tiles(Dirty_Tracker *dt, uint32_t const *frame, int tile_row, uint8_t dirty[DIRTY_TILES_X]) {
+
+    memset(dirty, 0, DIRTY_TILES_X);
+    int first_pixel = tile_row * DIRTY_TILE_SIZE * GB_PIXELS_X;
+
+    for (int y = 0; y < DIRTY_TILE_SIZE; y++) {
+        int row_start = first_pixel + (y * GB_PIXELS_X);
+        for (int tx = 0; tx < DIRTY_TILES_X; tx++) {
+            int offset = row_start + (tx * DIRTY_TILE_SIZE);
+            if (!dirty[tx] && memcmp(&frame[offset], &dt->previous[offset], TILE_ROW_BYTES) != 0) {
+                dirty[tx] = 1;
+            }
+        }
+    }
+
+    for (int tx = 0; tx < DIRTY_TILES_X; tx++) {
+        if (dirty[tx]) {
+            for (int y = 0; y < DIRTY_TILE_SIZE; y++) {
+                int offset = first_pixel + (y * GB_PIXELS_X) + (tx * DIRTY_TILE_SIZE);
+                memcpy(&dt->previous[offset], &frame[offset], TILE_ROW_BYTES);
+            }
+        }
+    }
+}
+
+int present_dirty_rects(Dirty_Tracker *dt, uint32_t const *frame, Blit_Rect blit, void *ctx) {
+
+    dt->frames_since_refresh++;
+    if (dt->refresh_pending ||
+       (dt->refresh_interval > 0 && dt->frames_since_refresh >= dt->refresh_interval)) {
+
+        memcpy(dt->previous, frame, sizeof(dt->previous));
+        dt->refresh_pending = 0;
+        dt->frames_since_refresh = 0;
+
+        Dirty_Rect screen = {0, 0, GB_PIXELS_X, GB_PIXELS_Y};
+        blit(ctx, &screen);
+        return 1;
+    }
+
+    /* Runs of changed tiles in each row of tiles are merged with a run
+     * of the same position and width in the row above, any which can't
+     * be extended any further are output */
+    Dirty_Rect open[DIRTY_TILES_X];
+    int open_count = 0;
+    int rect_count = 0;
+
+    for (int ty = 0; ty < DIRTY_TILES_Y; ty++) {
+        uint8_t dirty[DIRTY_TILES_X];
+        find_dirty_tiles(dt, frame, ty, dirty);
+
+        Dirty_Rect runs[DIRTY_TILES_X];
+        int run_count = 0;
+        for (int tx = 0; tx < DIRTY_TILES_X; tx++) {
+            if (!dirty[tx]) {
+                continue;
+            }
+            int start = tx;
+            while (tx + 1 < DIRTY_TILES_X && dirty[tx + 1]) {
+                tx++;
+            }
+            Dirty_Rect run = {start * DIRTY_TILE_SIZE, ty * DIRTY_TILE_SIZE,
+                              (tx - start + 1) * DIRTY_TILE_SIZE, DIRTY_TILE_SIZE};
+            runs[run_count++] = run;
+        }
+
+        uint8_t run_merged[DIRTY_TILES_X] = {0};
+        Dirty_Rect next_open[DIRTY_TILES_X];
+        int next_open_count = 0;
+
+        for (int i = 0; i < open_count; i++) {
+            int merged = 0;
+            for (int r = 0; r < run_count; r++) {
+                if (!run_merged[r] && runs[r].x == open[i].x && runs[r].width == open[i].width) {
+                    open[i].height += DIRTY_TILE_SIZE;
+                    run_merged[r] = 1;
+                    merged = 1;
+                    break;
+                }
+            }
+
+            if (merged) {
+                next_open[next_open_count++] = open[i];
+            } else {
+                blit(ctx, &open[i]);
+                rect_count++;
+            }
+        }
+
+        for (int r = 0; r < run_count; r++) {
+            if (!run_merged[r]) {
+                next_open[next_open_count++] = runs[r];
+            }
+        }
+
+        memcpy(open, next_open, next_open_count * sizeof(Dirty_Rect));
+        open_count = next_open_count;
+    }
+
+    for (int i = 0; i < open_count; i++) {
+        blit(ctx, &open[i]);
+        rect_count++;
+    }
+
+    return rect_count;
+}
@@ -0,0 +1,44 @@
+#ifndef DIRTY_RECTS_H
+#define DIRTY_RECTS_H
+
+#include <stdint.h>
+#include "../non_core/graphics_out.h"
+
+/* Frames are compared in 8x8 tiles, changed tiles are merged
+ * into rectangles which are all that needs to be output */
+#define DIRTY_TILE_SIZE 8
+#define DIRTY_TILES_X (GB_PIXELS_X / DIRTY_TILE_SIZE)
+#define DIRTY_TILES_Y (GB_PIXELS_Y / DIRTY_TILE_SIZE)
+
+// Region of the screen in Gameboy pixels
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+} Dirty_Rect;
+
+typedef struct {
+    uint32_t previous[GB_PIXELS_X * GB_PIXELS_Y]; // Last frame presented
+    int refresh_interval; // Frames between full refreshes, 0 for never
+    int frames_since_refresh;
+    int refresh_pending;
+} Dirty_Tracker;
+
+// Called for each changed region, ctx is passed through from present_dirty_rects
+typedef void (*Blit_Rect)(void *ctx, Dirty_Rect const *rect);
+
+/* Initialize the tracker, the first frame presented is always
+ * output in full as well as every refresh_interval frames after */
+void init_dirty_tracker(Dirty_Tracker *dt, int refresh_interval);
+
+/* Output the whole of the next frame, for when the screen
+ * has been overwritten or the output has changed scale */
+void force_full_refresh(Dirty_Tracker *dt);
+
+/* Compare the frame to the previously presented frame, calling blit
+ * for every region which has changed.
+ * returns the number of regions output */
+int present_dirty_rects(Dirty_Tracker *dt, uint32_t const *frame, Blit_Rect blit, void *ctx);
+
+#endif /* DIRTY_RECTS_H */
@@ -0,0 +1,93 @@
+#include "frame_reader.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int open_frame_reader(Frame_Reader *fr, char const *name) {
+
+    fr->segment = NULL;
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Frame_Export_Segment)) {
+        close(fd);
+        return 0;
+    }
+
+    void *mem = mmap(NULL, sizeof(Frame_Export_Segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return 0;
+    }
+
+    Frame_Export_Segment const *segment = mem;
+    if (__atomic_load_n(&segment->header.magic, __ATOMIC_ACQUIRE) != FRAME_EXPORT_MAGIC ||
+        segment->header.version != FRAME_EXPORT_VERSION) {
+        munmap(mem, sizeof(Frame_Export_Segment));
+        return 0;
+    }
+
+    fr->segment = segment;
+    return 1;
+}
+
+void close_frame_reader(Frame_Reader *fr) {
+    if (fr->segment != NULL) {
+        munmap((void *)fr->segment, sizeof(Frame_Export_Segment));
+        fr->segment = NULL;
+    }
+}
+
+uint64_t exported_frames(Frame_Reader const *fr) {
+    return __atomic_load_n(&fr->segment->header.frames, __ATOMIC_ACQUIRE);
+}
+
+int begin_frame_view(Frame_Reader const *fr, Frame_View *view) {
+
+    Frame_Export_Header const *header = &fr->segment->header;
+
+    for (;;) {
+        uint64_t frames = __atomic_load_n(&header->frames, __ATOMIC_ACQUIRE);
+        if (frames == 0) {
+            return 0;
+        }
+
+        int slot = (frames - 1) % FRAME_EXPORT_SLOTS;
+        uint64_t sequence = __atomic_load_n(&header->slot_sequence[slot], __ATOMIC_ACQUIRE);
+        // Already being overwritten by the frame after next
+        if (sequence & 1) {
+            continue;
+        }
+
+        view->pixels = fr->segment->pixels[slot];
+        view->frame = __atomic_load_n(&header->slot_frame[slot], __ATOMIC_RELAXED);
+        view->slot = slot;
+        view->sequence = sequence;
+        return 1;
+    }
+}
+
+int end_frame_view(Frame_Reader const *fr, Frame_View const *view) {
+    // Everything read from the slot has to be read before the sequence is checked again
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&fr->segment->header.slot_sequence[view->slot], __ATOMIC_RELAXED) == view->sequence;
+}
+
+uint64_t read_frame(Frame_Reader const *fr, uint32_t *dest) {
+
+    Frame_View view;
+    do {
+        if (!begin_frame_view(fr, &view)) {
+            return 0;
+        }
+        memcpy(dest, view.pixels, sizeof(fr->segment->pixels[0]));
+    } while (!end_frame_view(fr, &view));
+
+    return view.frame;
+}
@@ -0,0 +1,44 @@
+#ifndef FRAME_READER_H
+#define FRAME_READER_H
+
+#include <stdint.h>
+#include "../core/frame_export.h"
+
+/* Reads frames exported to shared memory by a running
+ * emulator built with FRAME_EXPORT, see frame_export.h */
+typedef struct {
+    Frame_Export_Segment const *segment;
+} Frame_Reader;
+
+// A frame being read in place
+typedef struct {
+    uint32_t const *pixels;
+    uint64_t frame; // Frame number, counting from 1
+    int slot;
+    uint64_t sequence;
+} Frame_View;
+
+/* Map the shared memory segment with the given name read only
+ * returns 1 if successful, 0 otherwise */
+int open_frame_reader(Frame_Reader *fr, char const *name);
+
+void close_frame_reader(Frame_Reader *fr);
+
+// Obtain the number of frames exported so far
+uint64_t exported_frames(Frame_Reader const *fr);
+
+/* Start reading the latest frame in place, its pixels can be read until
+ * end_frame_view is called, but may be overwritten if not read quickly.
+ * returns 1 if successful, 0 if no frame has been exported yet */
+int begin_frame_view(Frame_Reader const *fr, Frame_View *view);
+
+/* Check the frame wasn't overwritten while it was being read
+ * returns 1 if everything read was from the frame, 0 otherwise */
+int end_frame_view(Frame_Reader const *fr, Frame_View const *view);
+
+/* Copy the latest frame (FRAME_EXPORT_WIDTH x FRAME_EXPORT_HEIGHT
+ * pixels) to dest, retrying if it's overwritten during the copy.
+ * returns the frame number, or 0 if no frame has been exported yet */
+uint64_t read_frame(Frame_Reader const *fr, uint32_t *dest);
+
+#endif /* FRAME_READER_H */
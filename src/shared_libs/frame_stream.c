@@ -0,0 +1,354 @@
+#include "frame_stream.h"
+
+#include <string.h>
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static uint16_t get_u16(uint8_t const *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(uint8_t const *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+/* Packbits, a header byte of 0 - 127 is followed by that many + 1
+ * literal bytes, 129 - 255 by a byte repeated 257 - header times */
+static unsigned long pack_bits(uint8_t const *src, unsigned long size, uint8_t *dest) {
+
+    uint8_t *out = dest;
+    unsigned long i = 0;
+
+    while (i < size) {
+        unsigned long run = 1;
+        while (i + run < size && run < 128 && src[i + run] == src[i]) {
+            run++;
+        }
+
+        if (run >= 3) {
+            *out++ = 257 - run;
+            *out++ = src[i];
+            i += run;
+            continue;
+        }
+
+        // Literals until the next run worth encoding
+        unsigned long start = i;
+        while (i < size && i - start < 128) {
+            if (i + 2 < size && src[i] == src[i + 1] && src[i] == src[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        *out++ = (i - start) - 1;
+        memcpy(out, &src[start], i - start);
+        out += i - start;
+    }
+    return out - dest;
+}
+
+/* returns the number of bytes unpacked, or 0 if the input is
+ * invalid or would unpack to more than max bytes */
+static unsigned long unpack_bits(uint8_t const *src, unsigned long size, uint8_t *dest, unsigned long max) {
+
+    unsigned long in = 0;
+    unsigned long out = 0;
+
+    while (in < size) {
+        uint8_t header = src[in++];
+        if (header < 128) {
+            unsigned long count = header + 1;
+            if (in + count > size || out + count > max) {
+                return 0;
+            }
+            memcpy(&dest[out], &src[in], count);
+            in += count;
+            out += count;
+        } else if (header > 128) {
+            unsigned long count = 257 - header;
+            if (in >= size || out + count > max) {
+                return 0;
+            }
+            memset(&dest[out], src[in++], count);
+            out += count;
+        }
+    }
+    return out;
+}
+
+
+static void clear_palette(Stream_Encoder *se) {
+    se->palette_size = 0;
+    memset(se->hash_indexes, 0xFF, sizeof(se->hash_indexes));
+}
+
+void init_stream_encoder(Stream_Encoder *se) {
+    clear_palette(se);
+    se->needs_reset = 1;
+    se->frames = 0;
+    se->total_bytes = 0;
+    se->last_bytes = 0;
+}
+
+void force_key_frame(Stream_Encoder *se) {
+    se->needs_reset = 1;
+}
+
+void get_stream_stats(Stream_Encoder const *se, unsigned long *frames,
+                      unsigned long long *total_bytes, unsigned long *last_bytes) {
+    *frames = se->frames;
+    *total_bytes = se->total_bytes;
+    *last_bytes = se->last_bytes;
+}
+
+/* Find the palette index of a colour, adding it to the palette if new
+ * returns the index, or -1 if the palette is full */
+static int color_index(Stream_Encoder *se, uint32_t color) {
+
+    unsigned slot = ((color * 2654435761u) >> 22) & (STREAM_HASH_SIZE - 1);
+    while (se->hash_indexes[slot] >= 0) {
+        if (se->hash_colors[slot] == color) {
+            return se->hash_indexes[slot];
+        }
+        slot = (slot + 1) & (STREAM_HASH_SIZE - 1);
+    }
+
+    if (se->palette_size == STREAM_MAX_COLORS) {
+        return -1;
+    }
+    se->hash_colors[slot] = color;
+    se->hash_indexes[slot] = se->palette_size;
+    se->palette[se->palette_size] = color;
+    return se->palette_size++;
+}
+
+/* Index every pixel of the dirty tiles
+ * returns 1 if successful, 0 if the palette filled up */
+static int index_tiles(Stream_Encoder *se, uint32_t const *pixels, uint8_t const *dirty) {
+
+    for (int t = 0; t < STREAM_TILES; t++) {
+        if (!dirty[t]) {
+            continue;
+        }
+        int first = ((t / STREAM_TILES_X) * STREAM_TILE_SIZE * STREAM_WIDTH) + ((t % STREAM_TILES_X) * STREAM_TILE_SIZE);
+        for (int y = 0; y < STREAM_TILE_SIZE; y++) {
+            for (int x = 0; x < STREAM_TILE_SIZE; x++) {
+                int i = first + (y * STREAM_WIDTH) + x;
+                int index = color_index(se, pixels[i]);
+                if (index < 0) {
+                    return 0;
+                }
+                se->indexes[i] = index;
+            }
+        }
+    }
+    return 1;
+}
+
+static int bits_per_pixel(int palette_size) {
+    if (palette_size <= 2) {
+        return 1;
+    }
+    if (palette_size <= 4) {
+        return 2;
+    }
+    return palette_size <= 16 ? 4 : 8;
+}
+
+// Pack the dirty tiles after the bitmap, returns the body size
+static unsigned long pack_tiles(Stream_Encoder *se, uint32_t const *pixels, uint8_t const *dirty, int bpp) {
+
+    uint8_t *out = se->body;
+    memset(out, 0, STREAM_BITMAP_SIZE);
+    for (int t = 0; t < STREAM_TILES; t++) {
+        if (dirty[t]) {
+            out[t / 8] |= 1 << (t % 8);
+        }
+    }
+    out += STREAM_BITMAP_SIZE;
+
+    for (int t = 0; t < STREAM_TILES; t++) {
+        if (!dirty[t]) {
+            continue;
+        }
+        int first = ((t / STREAM_TILES_X) * STREAM_TILE_SIZE * STREAM_WIDTH) + ((t % STREAM_TILES_X) * STREAM_TILE_SIZE);
+        for (int y = 0; y < STREAM_TILE_SIZE; y++) {
+            int row = first + (y * STREAM_WIDTH);
+            if (bpp == 32) {
+                for (int x = 0; x < STREAM_TILE_SIZE; x++, out += 4) {
+                    put_u32(out, pixels[row + x]);
+                }
+                continue;
+            }
+
+            int per_byte = 8 / bpp;
+            for (int x = 0; x < STREAM_TILE_SIZE; x += per_byte) {
+                uint8_t b = 0;
+                for (int i = 0; i < per_byte; i++) {
+                    b = (b << bpp) | se->indexes[row + x + i];
+                }
+                *out++ = b;
+            }
+        }
+    }
+    return out - se->body;
+}
+
+unsigned long encode_stream_frame(Stream_Encoder *se, uint32_t const *pixels, uint8_t *dest) {
+
+    uint8_t dirty[STREAM_TILES];
+    int flags = 0;
+
+    if (se->needs_reset) {
+        clear_palette(se);
+        flags |= STREAM_PALETTE_RESET;
+        memset(dirty, 1, sizeof(dirty));
+    } else {
+        for (int t = 0; t < STREAM_TILES; t++) {
+            int first = ((t / STREAM_TILES_X) * STREAM_TILE_SIZE * STREAM_WIDTH) + ((t % STREAM_TILES_X) * STREAM_TILE_SIZE);
+            dirty[t] = 0;
+            for (int y = 0; y < STREAM_TILE_SIZE && !dirty[t]; y++) {
+                int row = first + (y * STREAM_WIDTH);
+                dirty[t] = memcmp(&pixels[row], &se->previous[row], STREAM_TILE_SIZE * sizeof(uint32_t)) != 0;
+            }
+        }
+    }
+
+    int first_new = se->palette_size;
+    if (!index_tiles(se, pixels, dirty)) {
+        // Start a new palette with just this frame's colours
+        clear_palette(se);
+        flags |= STREAM_PALETTE_RESET;
+        memset(dirty, 1, sizeof(dirty));
+        first_new = 0;
+        if (!index_tiles(se, pixels, dirty)) {
+            clear_palette(se);
+            flags |= STREAM_DIRECT;
+        }
+    }
+    if (flags & STREAM_PALETTE_RESET) {
+        first_new = 0;
+    }
+
+    int bpp = (flags & STREAM_DIRECT) ? 32 : bits_per_pixel(se->palette_size);
+    int added = se->palette_size - first_new;
+
+    uint8_t *out = dest + 4;
+    *out++ = flags;
+    *out++ = bpp;
+    put_u16(out, added);
+    out += 2;
+    for (int i = 0; i < added; i++, out += 4) {
+        put_u32(out, se->palette[first_new + i]);
+    }
+
+    unsigned long body_size = pack_tiles(se, pixels, dirty, bpp);
+    unsigned long packed_size = pack_bits(se->body, body_size, out + 4);
+    put_u32(out, packed_size);
+    out += 4 + packed_size;
+
+    unsigned long size = out - dest;
+    put_u32(dest, size - 4);
+
+    memcpy(se->previous, pixels, sizeof(se->previous));
+    // Indexes of tiles sent directly weren't updated
+    se->needs_reset = (flags & STREAM_DIRECT) != 0;
+
+    se->frames++;
+    se->total_bytes += size;
+    se->last_bytes = size;
+    return size;
+}
+
+
+void init_stream_decoder(Stream_Decoder *sd) {
+    memset(sd->pixels, 0, sizeof(sd->pixels));
+    sd->palette_size = 0;
+}
+
+unsigned long decode_stream_frame(Stream_Decoder *sd, uint8_t const *src, unsigned long size) {
+
+    if (size < STREAM_HEADER_SIZE || get_u32(src) > size - 4) {
+        return 0;
+    }
+    unsigned long end = 4 + get_u32(src);
+    unsigned long pos = 4;
+
+    int flags = src[pos++];
+    int bpp = src[pos++];
+    int added = get_u16(&src[pos]);
+    pos += 2;
+    if (bpp != 1 && bpp != 2 && bpp != 4 && bpp != 8 && bpp != 32) {
+        return 0;
+    }
+
+    if (flags & STREAM_PALETTE_RESET) {
+        sd->palette_size = 0;
+    }
+    if (sd->palette_size + added > STREAM_MAX_COLORS || pos + (added * 4) + 4 > end) {
+        return 0;
+    }
+    for (int i = 0; i < added; i++, pos += 4) {
+        sd->palette[sd->palette_size++] = get_u32(&src[pos]);
+    }
+
+    unsigned long packed_size = get_u32(&src[pos]);
+    pos += 4;
+    if (pos + packed_size != end) {
+        return 0;
+    }
+    unsigned long body_size = unpack_bits(&src[pos], packed_size, sd->body, sizeof(sd->body));
+    if (body_size < STREAM_BITMAP_SIZE) {
+        return 0;
+    }
+
+    int sent = 0;
+    for (int t = 0; t < STREAM_TILES; t++) {
+        sent += (sd->body[t / 8] >> (t % 8)) & 1;
+    }
+    int tile_bytes = (STREAM_TILE_SIZE * STREAM_TILE_SIZE * bpp) / 8;
+    if (body_size != STREAM_BITMAP_SIZE + ((unsigned long)sent * tile_bytes)) {
+        return 0;
+    }
+
+    uint8_t const *in = sd->body + STREAM_BITMAP_SIZE;
+    for (int t = 0; t < STREAM_TILES; t++) {
+        if (!((sd->body[t / 8] >> (t % 8)) & 1)) {
+            continue;
+        }
+        int first = ((t / STREAM_TILES_X) * STREAM_TILE_SIZE * STREAM_WIDTH) + ((t % STREAM_TILES_X) * STREAM_TILE_SIZE);
+        for (int y = 0; y < STREAM_TILE_SIZE; y++) {
+            uint32_t *row = &sd->pixels[first + (y * STREAM_WIDTH)];
+            if (bpp == 32) {
+                for (int x = 0; x < STREAM_TILE_SIZE; x++, in += 4) {
+                    row[x] = get_u32(in);
+                }
+                continue;
+            }
+
+            int per_byte = 8 / bpp;
+            int mask = (1 << bpp) - 1;
+            for (int x = 0; x < STREAM_TILE_SIZE; x += per_byte, in++) {
+                for (int i = 0; i < per_byte; i++) {
+                    int index = (*in >> ((per_byte - 1 - i) * bpp)) & mask;
+                    if (index >= sd->palette_size) {
+                        return 0;
+                    }
+                    row[x + i] = sd->palette[index];
+                }
+            }
+        }
+    }
+    return end;
+}
@@ -0,0 +1,83 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <stdint.h>
+
+/* Lossless frame stream for sending screens to remote viewers. Only
+ * 8x8 tiles which changed since the previous frame are sent, as indexes
+ * into a palette of the colours seen so far. The palette is kept between
+ * frames, so a DMG screen is sent at 2 bits per pixel. Frames with more
+ * than 256 colours send changed tiles as 32 bit colours instead.
+ *
+ * Each encoded frame, all values little endian:
+ *   uint32 number of bytes following
+ *   uint8  flags (STREAM_PALETTE_RESET, STREAM_DIRECT)
+ *   uint8  bits per pixel (1, 2, 4, 8 or 32)
+ *   uint16 number of palette entries added, then each as uint32
+ *   uint32 body size, then the body packbits compressed:
+ *     a bit per tile (row major, lowest bit first) set if sent, then
+ *     each sent tile's rows with pixels packed highest bits first */
+#define STREAM_WIDTH 160
+#define STREAM_HEIGHT 144
+#define STREAM_TILE_SIZE 8
+#define STREAM_TILES_X (STREAM_WIDTH / STREAM_TILE_SIZE)
+#define STREAM_TILES_Y (STREAM_HEIGHT / STREAM_TILE_SIZE)
+#define STREAM_TILES (STREAM_TILES_X * STREAM_TILES_Y)
+#define STREAM_PIXELS (STREAM_WIDTH * STREAM_HEIGHT)
+#define STREAM_MAX_COLORS 256
+
+#define STREAM_PALETTE_RESET 0x1 // Palette starts again, every tile is sent
+#define STREAM_DIRECT 0x2 // Tiles are sent as 32 bit colours
+
+#define STREAM_HEADER_SIZE 12 // Without the palette entries
+#define STREAM_HASH_SIZE 1024 // Colour lookup table, must be a power of 2
+#define STREAM_BITMAP_SIZE ((STREAM_TILES + 7) / 8)
+#define STREAM_MAX_BODY (STREAM_BITMAP_SIZE + (STREAM_PIXELS * 4))
+// Largest possible encoded frame, packbits adds at most 1 byte per 128
+#define STREAM_MAX_FRAME_SIZE (STREAM_HEADER_SIZE + (STREAM_MAX_COLORS * 4) + \
+                               STREAM_MAX_BODY + (STREAM_MAX_BODY / 128) + 1)
+
+typedef struct {
+    uint32_t previous[STREAM_PIXELS];
+    uint8_t indexes[STREAM_PIXELS];
+    uint32_t palette[STREAM_MAX_COLORS];
+    int palette_size;
+    uint32_t hash_colors[STREAM_HASH_SIZE];
+    int16_t hash_indexes[STREAM_HASH_SIZE]; // -1 if empty
+    int needs_reset; // No previous frame or palette to build on
+    uint8_t body[STREAM_MAX_BODY];
+
+    unsigned long frames;
+    unsigned long long total_bytes;
+    unsigned long last_bytes;
+} Stream_Encoder;
+
+typedef struct {
+    uint32_t pixels[STREAM_PIXELS];
+    uint32_t palette[STREAM_MAX_COLORS];
+    int palette_size;
+    uint8_t body[STREAM_MAX_BODY];
+} Stream_Decoder;
+
+void init_stream_encoder(Stream_Encoder *se);
+
+// Send every tile with a new palette in the next frame
+void force_key_frame(Stream_Encoder *se);
+
+/* Encode a 160x144 frame of 0xXXRRGGBB pixels into dest, which must
+ * have room for STREAM_MAX_FRAME_SIZE bytes.
+ * returns the number of bytes written */
+unsigned long encode_stream_frame(Stream_Encoder *se, uint32_t const *pixels, uint8_t *dest);
+
+/* Obtain the number of frames encoded, the total bytes
+ * and the size of the last frame in bytes */
+void get_stream_stats(Stream_Encoder const *se, unsigned long *frames,
+                      unsigned long long *total_bytes, unsigned long *last_bytes);
+
+void init_stream_decoder(Stream_Decoder *sd);
+
+/* Apply an encoded frame of size bytes, the decoded frame is left in
+ * sd->pixels. returns the number of bytes read, 0 if invalid */
+unsigned long decode_stream_frame(Stream_Decoder *sd, uint8_t const *src, unsigned long size);
+
+#endif /* FRAME_STREAM_H */
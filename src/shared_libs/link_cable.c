@@ -0,0 +1,115 @@
+#include "link_cable.h"
+
+#include <string.h>
+
+static int ring_push(Link_Ring *r, uint8_t val) {
+    uint32_t head = r->head;
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == LINK_RING_SIZE) {
+        return 0;
+    }
+    r->data[head & (LINK_RING_SIZE - 1)] = val;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static int ring_pop(Link_Ring *r, uint8_t *val) {
+    uint32_t tail = r->tail;
+    if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) {
+        return 0;
+    }
+    *val = r->data[tail & (LINK_RING_SIZE - 1)];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+
+void init_link_cable(Link_Cable *lc) {
+    memset(lc, 0, sizeof(Link_Cable));
+    __atomic_store_n(&lc->magic, LINK_CABLE_MAGIC, __ATOMIC_RELEASE);
+}
+
+int attach_link_end(Link_End *le, Link_Cable *lc, int side) {
+
+    uint32_t detached = 0;
+    if (side < 0 || side > 1 || !__atomic_compare_exchange_n(&lc->attached[side], &detached, 1, 0,
+                                                             __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    le->cable = lc;
+    le->side = side;
+    le->offered = 0;
+    le->clocking = 0;
+    // Start level with the other side, however long it has been running
+    le->cycles = __atomic_load_n(&lc->cycles[!side], __ATOMIC_ACQUIRE);
+    __atomic_store_n(&lc->cycles[side], le->cycles, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void detach_link_end(Link_End *le) {
+    if (le->cable != NULL) {
+        __atomic_store_n(&le->cable->clocking[le->side], 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&le->cable->attached[le->side], 0, __ATOMIC_RELEASE);
+        le->cable = NULL;
+    }
+}
+
+static int peer_attached(Link_End const *le) {
+    return __atomic_load_n(&le->cable->attached[!le->side], __ATOMIC_ACQUIRE);
+}
+
+static uint64_t peer_cycles(Link_End const *le) {
+    return __atomic_load_n(&le->cable->cycles[!le->side], __ATOMIC_ACQUIRE);
+}
+
+
+Link_Status link_transfer_int(Link_End *le, uint8_t data, uint8_t *recv) {
+
+    Link_Cable *lc = le->cable;
+    Link_Ring *out = &lc->rings[le->side];
+    Link_Ring *in = &lc->rings[!le->side];
+    Link_Status status = LINK_WAITING;
+
+    // The other side may already be ahead, give it a whole window from here
+    if (!le->clocking) {
+        uint64_t peer = peer_cycles(le);
+        le->clock_from = peer > le->cycles ? peer : le->cycles;
+    }
+    // Room to reply is checked first so an offer is never taken without one
+    if (out->head - __atomic_load_n(&out->tail, __ATOMIC_ACQUIRE) < LINK_RING_SIZE && ring_pop(in, recv)) {
+        ring_push(out, data);
+        status = LINK_DONE;
+    } else if (!peer_attached(le) || peer_cycles(le) >= le->clock_from + LINK_WINDOW_CYCLES ||
+               __atomic_load_n(&lc->clocking[!le->side], __ATOMIC_ACQUIRE)) {
+        status = LINK_NO_PEER;
+    }
+    le->clocking = status == LINK_WAITING;
+    __atomic_store_n(&lc->clocking[le->side], le->clocking, __ATOMIC_RELEASE);
+    return status;
+}
+
+Link_Status link_transfer_ext(Link_End *le, uint8_t data, uint8_t *recv) {
+
+    if (!le->offered) {
+        le->offered = ring_push(&le->cable->rings[le->side], data);
+    }
+    if (le->offered && ring_pop(&le->cable->rings[!le->side], recv)) {
+        le->offered = 0;
+        return LINK_DONE;
+    }
+    return LINK_WAITING;
+}
+
+void link_add_cycles(Link_End *le, unsigned long cycles) {
+    le->cycles += cycles;
+    __atomic_store_n(&le->cable->cycles[le->side], le->cycles, __ATOMIC_RELEASE);
+}
+
+int link_too_far_ahead(Link_End const *le) {
+    return peer_attached(le) && le->cycles > peer_cycles(le) + LINK_WINDOW_CYCLES &&
+           !__atomic_load_n(&le->cable->clocking[!le->side], __ATOMIC_ACQUIRE);
+}
+
+int link_data_waiting(Link_End const *le) {
+    Link_Ring const *in = &le->cable->rings[!le->side];
+    return __atomic_load_n(&in->head, __ATOMIC_ACQUIRE) != in->tail;
+}
@@ -0,0 +1,80 @@
+#ifndef LINK_CABLE_H
+#define LINK_CABLE_H
+
+#include <stdint.h>
+
+/* Link cable between two Gameboys running at the same time, in memory
+ * both can access (two threads, or two processes sharing memory).
+ * Each side sends bytes through its own single producer, single
+ * consumer ring, so neither needs a lock.
+ *
+ * A side using the external clock offers the byte in its SB register
+ * and waits. A side using the internal clock takes the offered byte and
+ * sends its own back, completing the transfer for both.
+ *
+ * Each side also publishes the cycles it has run. A side which gets
+ * more than LINK_WINDOW_CYCLES ahead of the other should wait for it,
+ * so both run at full speed without drifting apart, unless the other
+ * is waiting for it to offer a byte. */
+#define LINK_CABLE_MAGIC 0x4B4E4C47 // "GLNK"
+#define LINK_RING_SIZE 64 // Must be a power of 2
+#define LINK_WINDOW_CYCLES (2 * 70224) // 2 frames
+
+typedef struct {
+    uint8_t data[LINK_RING_SIZE];
+    uint32_t head; // Only written by the sending side
+    uint32_t tail; // Only written by the receiving side
+} Link_Ring;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t attached[2];
+    uint32_t clocking[2]; // Waiting in link_transfer_int
+    uint64_t cycles[2];
+    Link_Ring rings[2]; // Bytes sent by each side
+} Link_Cable;
+
+typedef struct {
+    Link_Cable *cable;
+    int side; // 0 or 1
+    int offered; // Byte offered for an external clock transfer
+    int clocking;
+    uint64_t cycles;
+    uint64_t clock_from; // Other side's cycles when clocking started
+} Link_End;
+
+typedef enum {LINK_WAITING, LINK_DONE, LINK_NO_PEER} Link_Status;
+
+// Clear a new cable, neither side is attached
+void init_link_cable(Link_Cable *lc);
+
+/* Plug one end of the cable (side 0 or 1) in.
+ * returns 1 if successful, 0 if that side is already in use */
+int attach_link_end(Link_End *le, Link_Cable *lc, int side);
+
+void detach_link_end(Link_End *le);
+
+/* Transfer using the internal clock, exchanging data with the byte the
+ * other side offered. returns LINK_DONE with the byte received in recv,
+ * LINK_WAITING if nothing has been offered yet, or LINK_NO_PEER if the
+ * other side isn't attached, is using its internal clock too or has run
+ * a whole window since this side started waiting without offering a byte */
+Link_Status link_transfer_int(Link_End *le, uint8_t data, uint8_t *recv);
+
+/* Transfer using the external clock, offering data to the other side.
+ * returns LINK_DONE with the byte received in recv once the other side
+ * has clocked the transfer, LINK_WAITING otherwise */
+Link_Status link_transfer_ext(Link_End *le, uint8_t data, uint8_t *recv);
+
+// Publish the cycles run since last called
+void link_add_cycles(Link_End *le, unsigned long cycles);
+
+/* returns 1 if this side is more than LINK_WINDOW_CYCLES ahead of
+ * the other and should wait for it, 0 otherwise or if the other
+ * side is waiting for this one to offer a byte */
+int link_too_far_ahead(Link_End const *le);
+
+// returns 1 if the other side has sent a byte not taken yet, 0 otherwise
+int link_data_waiting(Link_End const *le);
+
+#endif /* LINK_CABLE_H */
@@ -0,0 +1,127 @@
+#ifdef LINK_CABLE
+
+/* Link cable backend for two emulator processes on the same machine.
+ * The server creates the cable in POSIX shared memory named after the
+ * port, and the client attaches to the other end of it */
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "link_cable.h"
+#include "../core/serial_io.h"
+#include "../non_core/serial_io_transfer.h"
+#include "../non_core/logger.h"
+
+static Link_Cable *cable = NULL;
+static Link_End end;
+static char cable_name[64];
+static int created = 0;
+
+void quit_io();
+
+static int open_cable(unsigned port, int create) {
+
+    snprintf(cable_name, sizeof(cable_name), "/uefiboy_link%d", port);
+    if (create) {
+        shm_unlink(cable_name);
+    }
+    int fd = shm_open(cable_name, create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, 0644);
+    if (fd < 0) {
+        log_message(LOG_ERROR, "Unable to open link cable %s\n", cable_name);
+        return 0;
+    }
+    if (create && ftruncate(fd, sizeof(Link_Cable)) != 0) {
+        log_message(LOG_ERROR, "Unable to size link cable %s\n", cable_name);
+        close(fd);
+        shm_unlink(cable_name);
+        return 0;
+    }
+
+    void *mem = mmap(NULL, sizeof(Link_Cable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        log_message(LOG_ERROR, "Unable to map link cable %s\n", cable_name);
+        return 0;
+    }
+    cable = mem;
+    created = create;
+    if (create) {
+        init_link_cable(cable);
+    } else if (__atomic_load_n(&cable->magic, __ATOMIC_ACQUIRE) != LINK_CABLE_MAGIC) {
+        log_message(LOG_ERROR, "Link cable %s not set up by a server\n", cable_name);
+        munmap(cable, sizeof(Link_Cable));
+        cable = NULL;
+        return 0;
+    }
+
+    if (!attach_link_end(&end, cable, !create)) {
+        log_message(LOG_ERROR, "Link cable %s already in use\n", cable_name);
+        munmap(cable, sizeof(Link_Cable));
+        cable = NULL;
+        return 0;
+    }
+    // The other side would wait for this one forever if left attached
+    atexit(quit_io);
+    log_message(LOG_INFO, "Connected to link cable %s\n", cable_name);
+    return 1;
+}
+
+int setup_server(unsigned port) {
+    return open_cable(port, 1);
+}
+
+int setup_client(unsigned port) {
+    return open_cable(port, 0);
+}
+
+void quit_io() {
+    if (cable == NULL) {
+        return;
+    }
+    detach_link_end(&end);
+    munmap(cable, sizeof(Link_Cable));
+    if (created) {
+        shm_unlink(cable_name);
+    }
+    cable = NULL;
+}
+
+// Transfer when current GB is using external clock
+// returns 1 if there is data to be recieved, 0 otherwise
+int transfer_ext(uint8_t data, uint8_t *recv) {
+    return cable != NULL && link_transfer_ext(&end, data, recv) == LINK_DONE;
+}
+
+// Transfer when current GB is using internal clock
+// returns 0xFF if no external GB found
+uint8_t transfer_int(uint8_t data) {
+
+    uint8_t recv;
+    Link_Status status = LINK_NO_PEER;
+    // The other side is running, it either offers a byte or runs a window ahead
+    while (cable != NULL && (status = link_transfer_int(&end, data, &recv)) == LINK_WAITING) {
+        sched_yield();
+    }
+    return status == LINK_DONE ? recv : 0xFF;
+}
+
+void link_sync(unsigned long cycles) {
+    if (cable == NULL) {
+        return;
+    }
+    link_add_cycles(&end, cycles);
+    while (link_too_far_ahead(&end)) {
+        sched_yield();
+    }
+    if (link_data_waiting(&end)) {
+        serial_data_ready();
+    }
+}
+
+#endif /* LINK_CABLE */
@@ -0,0 +1,233 @@
+#include "link_socket.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static int queue_push(Link_Queue *q, uint8_t val) {
+    if (q->len == LINK_SOCKET_BATCH) {
+        return 0;
+    }
+    q->data[(q->head + q->len++) % LINK_SOCKET_BATCH] = val;
+    return 1;
+}
+
+static int queue_pop(Link_Queue *q, uint8_t *val) {
+    if (q->len == 0) {
+        return 0;
+    }
+    *val = q->data[q->head];
+    q->head = (q->head + 1) % LINK_SOCKET_BATCH;
+    q->len--;
+    return 1;
+}
+
+
+/* Send as many queued messages as possible, or all of them if block.
+ * returns 0 if the connection was lost, 1 otherwise */
+static int flush(Link_Socket *ls, int block) {
+
+    Link_Queue *q = &ls->out;
+    while (q->len > 0) {
+        if (ls->fd < 0) {
+            return 0;
+        }
+        unsigned len = q->head + q->len > LINK_SOCKET_BATCH ? LINK_SOCKET_BATCH - q->head : q->len;
+        ssize_t sent = send(ls->fd, q->data + q->head, len, MSG_NOSIGNAL);
+        if (sent > 0) {
+            q->head = (q->head + sent) % LINK_SOCKET_BATCH;
+            q->len -= sent;
+            ls->sends++;
+            ls->bytes_sent += sent;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd p = {ls->fd, POLLOUT, 0};
+            if (!block) {
+                return 1;
+            } else if (poll(&p, 1, LINK_SOCKET_TIMEOUT_MS) <= 0) {
+                return 0;
+            }
+        } else if (sent == 0 || errno != EINTR) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int queue_message(Link_Socket *ls, uint8_t type, uint8_t val) {
+    if (ls->out.len + 2 > LINK_SOCKET_BATCH && !flush(ls, 1)) {
+        return 0;
+    }
+    queue_push(&ls->out, type);
+    queue_push(&ls->out, val);
+    return 1;
+}
+
+/* Read any messages already sent by the other side, without waiting.
+ * returns 0 if the connection was lost, 1 otherwise */
+static int receive(Link_Socket *ls) {
+
+    uint8_t buf[64];
+    for (;;) {
+        if (ls->fd < 0) {
+            return 0;
+        }
+        ssize_t len = recv(ls->fd, buf, sizeof(buf), 0);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        } else if (len < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        } else if (len == 0) {
+            return 0;
+        }
+
+        for (ssize_t i = 0; i < len; i++) {
+            if (ls->partial < 0) {
+                ls->partial = buf[i];
+                continue;
+            }
+            queue_push(ls->partial == LINK_MSG_CLOCK ? &ls->clocks : &ls->replies, buf[i]);
+            ls->partial = -1;
+        }
+    }
+}
+
+static int take_reply(Link_Socket *ls, uint8_t *val) {
+    // Replies to transfers which were given up on arrive first
+    while (ls->abandoned > 0 && queue_pop(&ls->replies, val)) {
+        ls->abandoned--;
+    }
+    return ls->abandoned == 0 && queue_pop(&ls->replies, val);
+}
+
+/* Wait for the reply to the oldest transfer clocked,
+ * returns 1 if successful, 0 if it didn't come in time */
+static int wait_reply(Link_Socket *ls, uint8_t *val) {
+    if (!flush(ls, 1)) {
+        return 0;
+    }
+    while (!take_reply(ls, val)) {
+        struct pollfd p = {ls->fd, POLLIN, 0};
+        if (poll(&p, 1, LINK_SOCKET_TIMEOUT_MS) <= 0 || !receive(ls)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+int link_socket_listen(unsigned port) {
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int link_socket_accept(Link_Socket *ls, int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return 0;
+    }
+    link_socket_init(ls, fd);
+    return 1;
+}
+
+int link_socket_connect(Link_Socket *ls, unsigned port) {
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return 0;
+    }
+    link_socket_init(ls, fd);
+    return 1;
+}
+
+void link_socket_init(Link_Socket *ls, int fd) {
+    memset(ls, 0, sizeof(Link_Socket));
+    ls->fd = fd;
+    ls->partial = -1;
+
+    // Batches are small, send them straight away
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+void link_socket_close(Link_Socket *ls) {
+    if (ls->fd >= 0) {
+        flush(ls, 1);
+        close(ls->fd);
+        ls->fd = -1;
+    }
+}
+
+
+Link_Status link_socket_int(Link_Socket *ls, uint8_t data, uint8_t *recv) {
+
+    ls->transfers++;
+    if (!queue_message(ls, LINK_MSG_CLOCK, data)) {
+        return LINK_NO_PEER;
+    }
+    if (!wait_reply(ls, recv)) {
+        ls->abandoned++;
+        return LINK_NO_PEER;
+    }
+    return LINK_DONE;
+}
+
+Link_Status link_socket_ext(Link_Socket *ls, uint8_t data, uint8_t *recv) {
+
+    if (!queue_pop(&ls->clocks, recv) && !(receive(ls) && queue_pop(&ls->clocks, recv))) {
+        return LINK_WAITING;
+    }
+    ls->transfers++;
+    // The other side may be waiting for the reply
+    queue_message(ls, LINK_MSG_REPLY, data);
+    flush(ls, 0);
+    return LINK_DONE;
+}
+
+int link_socket_poll(Link_Socket *ls) {
+    return flush(ls, 0) && receive(ls);
+}
+
+unsigned link_socket_stand_in(Link_Socket *ls, uint8_t (*reply)(uint8_t, void *), void *ctx) {
+
+    unsigned replied = 0;
+    uint8_t val;
+    receive(ls);
+    while (queue_pop(&ls->clocks, &val)) {
+        queue_message(ls, LINK_MSG_REPLY, reply(val, ctx));
+        replied++;
+    }
+    flush(ls, 1);
+    return replied;
+}
@@ -0,0 +1,74 @@
+#ifndef LINK_SOCKET_H
+#define LINK_SOCKET_H
+
+#include <stdint.h>
+
+#include "link_cable.h"
+
+/* Link cable over a loopback TCP socket, for two emulator processes on
+ * the same host. Each byte is sent as a message of 2 bytes, the type
+ * (a byte clocked by the sender's internal clock, or the reply to one)
+ * then the byte itself. Messages are queued and sent in batches on a
+ * non-blocking socket. The side clocking a transfer waits for the reply */
+#define LINK_SOCKET_BATCH 256 // Bytes queued before sending
+#define LINK_SOCKET_TIMEOUT_MS 1000 // Before giving up on a reply
+
+#define LINK_MSG_CLOCK 0x1
+#define LINK_MSG_REPLY 0x2
+
+typedef struct {
+    uint8_t data[LINK_SOCKET_BATCH];
+    unsigned head;
+    unsigned len;
+} Link_Queue;
+
+typedef struct {
+    int fd;
+    Link_Queue out; // Messages waiting to be sent
+    Link_Queue clocks; // Bytes clocked by the other side, waiting for a reply
+    Link_Queue replies; // Replies to bytes this side clocked
+    int partial; // First byte of a message, -1 if none
+
+    unsigned abandoned; // Replies to skip, for transfers which timed out
+
+    unsigned long transfers;
+    unsigned long sends;
+    unsigned long bytes_sent;
+} Link_Socket;
+
+/* Listen on the loopback interface, returns the listening socket
+ * or -1 if unsuccessful */
+int link_socket_listen(unsigned port);
+
+/* Wait for the other side to connect to a listening socket,
+ * returns 1 if successful, 0 otherwise */
+int link_socket_accept(Link_Socket *ls, int listen_fd);
+
+/* Connect to the other side listening on the loopback interface,
+ * returns 1 if successful, 0 otherwise */
+int link_socket_connect(Link_Socket *ls, unsigned port);
+
+// Start using a connected socket
+void link_socket_init(Link_Socket *ls, int fd);
+
+void link_socket_close(Link_Socket *ls);
+
+/* Transfer using the internal clock. returns LINK_DONE with the byte
+ * received in recv, or LINK_NO_PEER if no reply came in time */
+Link_Status link_socket_int(Link_Socket *ls, uint8_t data, uint8_t *recv);
+
+/* Transfer using the external clock, replying to a byte clocked by the
+ * other side. returns LINK_DONE with the byte received in recv,
+ * LINK_WAITING if the other side hasn't clocked one yet */
+Link_Status link_socket_ext(Link_Socket *ls, uint8_t data, uint8_t *recv);
+
+/* Send queued messages and read any sent by the other side, called
+ * regularly. returns 0 if the connection was lost, 1 otherwise */
+int link_socket_poll(Link_Socket *ls);
+
+/* Stand in for an emulator on the other side, replying to every byte
+ * clocked so far with reply(byte clocked, ctx).
+ * returns the number of bytes replied to */
+unsigned link_socket_stand_in(Link_Socket *ls, uint8_t (*reply)(uint8_t, void *), void *ctx);
+
+#endif /* LINK_SOCKET_H */
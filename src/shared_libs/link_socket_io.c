@@ -0,0 +1,88 @@
+#ifdef LINK_SOCKET
+
+/* Link cable backend over a loopback TCP socket, the server listens
+ * on the port and the client connects to it */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "link_socket.h"
+#include "../core/serial_io.h"
+#include "../non_core/serial_io_transfer.h"
+#include "../non_core/logger.h"
+
+static Link_Socket socket_link;
+static int connected = 0;
+
+void quit_io();
+
+static int start_link() {
+    connected = 1;
+    atexit(quit_io);
+    return 1;
+}
+
+/* Setup TCP Client, and attempt to connect
+ * to the server */
+int setup_client(unsigned port) {
+    if (!link_socket_connect(&socket_link, port)) {
+        log_message(LOG_ERROR, "Unable to connect to link on port %d\n", port);
+        return 0;
+    }
+    log_message(LOG_INFO, "Connected to link on port %d\n", port);
+    return start_link();
+}
+
+/*  Setup TCP Server, and wait for a single
+ *  client to connect */
+int setup_server(unsigned port) {
+    int listen_fd = link_socket_listen(port);
+    if (listen_fd < 0) {
+        log_message(LOG_ERROR, "Unable to listen for link on port %d\n", port);
+        return 0;
+    }
+    log_message(LOG_INFO, "Waiting for link on port %d\n", port);
+    int accepted = link_socket_accept(&socket_link, listen_fd);
+    close(listen_fd);
+    if (!accepted) {
+        log_message(LOG_ERROR, "No link connected on port %d\n", port);
+        return 0;
+    }
+    return start_link();
+}
+
+void quit_io() {
+    if (!connected) {
+        return;
+    }
+    log_message(LOG_INFO, "Link: %d transfers, %d sends\n",
+                (int)socket_link.transfers, (int)socket_link.sends);
+    link_socket_close(&socket_link);
+    connected = 0;
+}
+
+// Transfer when current GB is using external clock
+// returns 1 if there is data to be recieved, 0 otherwise
+int transfer_ext(uint8_t data, uint8_t *recv) {
+    return connected && link_socket_ext(&socket_link, data, recv) == LINK_DONE;
+}
+
+// Transfer when current GB is using internal clock
+// returns 0xFF if no external GB found
+uint8_t transfer_int(uint8_t data) {
+    uint8_t recv;
+    return connected && link_socket_int(&socket_link, data, &recv) == LINK_DONE ? recv : 0xFF;
+}
+
+void link_sync(unsigned long cycles) {
+    (void)cycles;
+    if (connected && !link_socket_poll(&socket_link)) {
+        log_message(LOG_WARN, "Link connection lost\n");
+        quit_io();
+    } else if (connected && socket_link.clocks.len > 0) {
+        serial_data_ready();
+    }
+}
+
+#endif /* LINK_SOCKET */
@@ -0,0 +1,211 @@
+#include "scaler.h"
+
+/* SIMD paths are compiled for x86 with GCC/Clang, each function is
+ * built for its own instruction set and only called once the CPU
+ * has been checked to support it. The SSE2 path is written with
+ * vector extensions rather than intrinsics, so needs no headers.
+ * SCALER_SSE2_ONLY leaves out the AVX2 path and its CPU checks, for
+ * x86_64 builds without the compiler's headers (like UEFI), as every
+ * x86_64 CPU has SSE2 */
+#if (defined(__x86_64__) || (defined(__i386__) && !defined(SCALER_SSE2_ONLY))) && \
+    defined(__GNUC__) && !defined(SCALER_NO_SIMD)
+#define SCALER_X86
+#ifndef SCALER_SSE2_ONLY
+#define SCALER_X86_AVX2
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+#endif
+
+static int simd_selected = 0;
+static Scaler_SIMD active_simd = SCALER_PORTABLE;
+
+
+static inline uint32_t to_format(uint32_t pixel, Scale_Format format) {
+    if (format == SCALE_RGBX) {
+        return (pixel & 0xFF00FF00) | ((pixel & 0xFF) << 16) | ((pixel >> 16) & 0xFF);
+    }
+    return pixel;
+}
+
+static void scale_row_portable(uint32_t const *src, int width, uint32_t *dest, int factor, Scale_Format format) {
+
+    for (int x = 0; x < width; x++) {
+        uint32_t pixel = to_format(src[x], format);
+        for (int i = 0; i < factor; i++) {
+            *dest++ = pixel;
+        }
+    }
+}
+
+
+#ifdef SCALER_X86
+
+static int cpu_supports_sse2() {
+#ifdef __x86_64__
+    return 1;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2);
+#endif
+}
+
+#ifdef SCALER_X86_AVX2
+static int cpu_supports_avx2() {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+        return 0;
+    }
+
+    // The OS (or firmware) has to have enabled saving the AVX registers
+    unsigned int xcr0_low, xcr0_high;
+    __asm__ volatile ("xgetbv" : "=a" (xcr0_low), "=d" (xcr0_high) : "c" (0));
+    if ((xcr0_low & 0x6) != 0x6) {
+        return 0;
+    }
+
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return 0;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & bit_AVX2) != 0;
+}
+#endif
+
+
+// 4 pixels, loaded and stored without needing to be aligned
+typedef uint32_t sse2_pixels __attribute__((vector_size(16), may_alias, aligned(4)));
+
+#ifdef __clang__
+#define SSE2_SHUFFLE(v, a, b, c, d) __builtin_shufflevector(v, v, a, b, c, d)
+#else
+#define SSE2_SHUFFLE(v, a, b, c, d) __builtin_shuffle(v, (sse2_pixels){a, b, c, d})
+#endif
+
+/* Store the kth group of 4 output pixels for 4 input pixels scaled by f,
+ * output pixel i is input pixel i / f */
+#define SSE2_EXPAND(f, k) *(sse2_pixels *)(dest + (4 * (k))) = \
+        SSE2_SHUFFLE(v, ((4 * (k)) / (f)) & 3, ((4 * (k) + 1) / (f)) & 3, \
+                     ((4 * (k) + 2) / (f)) & 3, ((4 * (k) + 3) / (f)) & 3)
+
+__attribute__((target("sse2")))
+static void scale_row_sse2(uint32_t const *src, int width, uint32_t *dest, int factor, Scale_Format format) {
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4, dest += 4 * factor) {
+        sse2_pixels v = *(sse2_pixels const *)(src + x);
+        if (format == SCALE_RGBX) {
+            v = (v & 0xFF00FF00) | ((v >> 16) & 0xFF) | ((v << 16) & 0xFF0000);
+        }
+
+        switch (factor) {
+            case 1: *(sse2_pixels *)dest = v; break;
+            case 2: SSE2_EXPAND(2, 0); SSE2_EXPAND(2, 1); break;
+            case 3: SSE2_EXPAND(3, 0); SSE2_EXPAND(3, 1); SSE2_EXPAND(3, 2); break;
+            case 4: SSE2_EXPAND(4, 0); SSE2_EXPAND(4, 1); SSE2_EXPAND(4, 2); SSE2_EXPAND(4, 3); break;
+            case 5: SSE2_EXPAND(5, 0); SSE2_EXPAND(5, 1); SSE2_EXPAND(5, 2); SSE2_EXPAND(5, 3);
+                    SSE2_EXPAND(5, 4); break;
+            case 6: SSE2_EXPAND(6, 0); SSE2_EXPAND(6, 1); SSE2_EXPAND(6, 2); SSE2_EXPAND(6, 3);
+                    SSE2_EXPAND(6, 4); SSE2_EXPAND(6, 5); break;
+            case 7: SSE2_EXPAND(7, 0); SSE2_EXPAND(7, 1); SSE2_EXPAND(7, 2); SSE2_EXPAND(7, 3);
+                    SSE2_EXPAND(7, 4); SSE2_EXPAND(7, 5); SSE2_EXPAND(7, 6); break;
+            case 8: SSE2_EXPAND(8, 0); SSE2_EXPAND(8, 1); SSE2_EXPAND(8, 2); SSE2_EXPAND(8, 3);
+                    SSE2_EXPAND(8, 4); SSE2_EXPAND(8, 5); SSE2_EXPAND(8, 6); SSE2_EXPAND(8, 7); break;
+        }
+    }
+
+    scale_row_portable(src + x, width - x, dest, factor, format);
+}
+
+
+#ifdef SCALER_X86_AVX2
+__attribute__((target("avx2")))
+static void scale_row_avx2(uint32_t const *src, int width, uint32_t *dest, int factor, Scale_Format format) {
+
+    // Output pixel i of each group of 8 * factor is input pixel i / factor
+    __m256i indexes[MAX_SCALE];
+    for (int k = 0; k < factor; k++) {
+        int i = 8 * k;
+        indexes[k] = _mm256_setr_epi32(i / factor, (i + 1) / factor, (i + 2) / factor, (i + 3) / factor,
+                (i + 4) / factor, (i + 5) / factor, (i + 6) / factor, (i + 7) / factor);
+    }
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8, dest += 8 * factor) {
+        __m256i v = _mm256_loadu_si256((__m256i const *)(src + x));
+        if (format == SCALE_RGBX) {
+            __m256i green_reserved = _mm256_and_si256(v, _mm256_set1_epi32(0xFF00FF00));
+            __m256i red = _mm256_and_si256(_mm256_srli_epi32(v, 16), _mm256_set1_epi32(0xFF));
+            __m256i blue = _mm256_and_si256(_mm256_slli_epi32(v, 16), _mm256_set1_epi32(0xFF0000));
+            v = _mm256_or_si256(green_reserved, _mm256_or_si256(red, blue));
+        }
+
+        for (int k = 0; k < factor; k++) {
+            _mm256_storeu_si256((__m256i *)(dest + (8 * k)), _mm256_permutevar8x32_epi32(v, indexes[k]));
+        }
+    }
+
+    scale_row_portable(src + x, width - x, dest, factor, format);
+}
+#endif
+
+#endif /* SCALER_X86 */
+
+
+Scaler_SIMD scaler_best_simd() {
+#ifdef SCALER_X86_AVX2
+    if (cpu_supports_avx2()) {
+        return SCALER_AVX2;
+    }
+#endif
+#ifdef SCALER_X86
+    if (cpu_supports_sse2()) {
+        return SCALER_SSE2;
+    }
+#endif
+    return SCALER_PORTABLE;
+}
+
+int scaler_set_simd(Scaler_SIMD simd) {
+    if (simd > scaler_best_simd()) {
+        return 0;
+    }
+    active_simd = simd;
+    simd_selected = 1;
+    return 1;
+}
+
+
+void scale_row(uint32_t const *src, int width, uint32_t *dest, int factor, Scale_Format format) {
+
+    if (!simd_selected) {
+        scaler_set_simd(scaler_best_simd());
+    }
+
+    switch (active_simd) {
+#ifdef SCALER_X86_AVX2
+        case SCALER_AVX2: scale_row_avx2(src, width, dest, factor, format); break;
+#endif
+#ifdef SCALER_X86
+        case SCALER_SSE2: scale_row_sse2(src, width, dest, factor, format); break;
+#endif
+        default: scale_row_portable(src, width, dest, factor, format); break;
+    }
+}
+
+int scale_pixels(uint32_t const *src, int width, int height, int src_stride,
+                 uint32_t *dest, int dest_stride, int factor, Scale_Format format) {
+
+    if (factor < 1 || factor > MAX_SCALE) {
+        return 0;
+    }
+
+    // Every output row is scaled from src, dest may be slow to read from
+    for (int y = 0; y < height; y++) {
+        for (int i = 0; i < factor; i++) {
+            scale_row(src + (y * src_stride), width, dest + (((y * factor) + i) * dest_stride), factor, format);
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,42 @@
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <stdint.h>
+
+#define MAX_SCALE 8
+
+/* Pixel layouts the scaler can output, input pixels
+ * are always 32 bit 0xXXRRGGBB values */
+typedef enum {
+    SCALE_BGRX = 0, // Blue, green, red, reserved bytes (same as the input)
+    SCALE_RGBX = 1  // Red, green, blue, reserved bytes
+} Scale_Format;
+
+// Instruction sets the scaler can use, in order of preference
+typedef enum {
+    SCALER_PORTABLE = 0,
+    SCALER_SSE2 = 1,
+    SCALER_AVX2 = 2
+} Scaler_SIMD;
+
+/* Obtain the best instruction set supported by
+ * both the build and the CPU (and its OS/firmware) */
+Scaler_SIMD scaler_best_simd();
+
+/* Use the given instruction set, defaults to the best supported
+ * returns 1 if successful, 0 if not supported */
+int scaler_set_simd(Scaler_SIMD simd);
+
+/* Scale a row of width pixels by the given factor (1 - MAX_SCALE)
+ * horizontally, writing width * factor pixels to dest in the given format */
+void scale_row(uint32_t const *src, int width, uint32_t *dest, int factor, Scale_Format format);
+
+/* Nearest neighbour scale a width x height image with src_stride pixels
+ * per row by the given factor (1 - MAX_SCALE) into dest, which has
+ * dest_stride pixels per row. dest is only written to, so can be a
+ * video frame buffer.
+ * returns 1 if successful, 0 if the factor is invalid */
+int scale_pixels(uint32_t const *src, int width, int height, int src_stride,
+                 uint32_t *dest, int dest_stride, int factor, Scale_Format format);
+
+#endif /* SCALER_H */
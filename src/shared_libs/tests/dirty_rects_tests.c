@@ -0,0 +1,143 @@
+#include "../dirty_rects.c"
+#include "minunit/minunit.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SCALE 4 // Output scale the mock blitter counts bytes at
+#define REFRESH_INTERVAL 10
+#define FULL_FRAME_BYTES (GB_PIXELS_X * GB_PIXELS_Y * SCALE * SCALE * 4)
+#define TILE_BYTES (DIRTY_TILE_SIZE * DIRTY_TILE_SIZE * SCALE * SCALE * 4)
+
+static Dirty_Tracker tracker;
+static uint32_t frame[GB_PIXELS_X * GB_PIXELS_Y];
+
+// Mock blitter results
+static long bytes_transferred;
+static int blits;
+static Dirty_Rect last_rect;
+
+
+static void mock_blit(void *ctx, Dirty_Rect const *rect) {
+    (void)ctx;
+    bytes_transferred += (long)rect->width * rect->height * SCALE * SCALE * 4;
+    blits++;
+    last_rect = *rect;
+}
+
+static void present() {
+    bytes_transferred = 0;
+    blits = 0;
+    present_dirty_rects(&tracker, frame, mock_blit, NULL);
+}
+
+static void set_pixel(int x, int y, uint32_t color) {
+    frame[(y * GB_PIXELS_X) + x] = color;
+}
+
+
+void setup() {
+    for (int i = 0; i < GB_PIXELS_X * GB_PIXELS_Y; i++) {
+        frame[i] = 0xFFFFFF;
+    }
+    init_dirty_tracker(&tracker, REFRESH_INTERVAL);
+    present(); // First frame is always output in full
+}
+
+void teardown() {
+    //Nothing
+}
+
+
+MU_TEST(first_frame_full) {
+    init_dirty_tracker(&tracker, REFRESH_INTERVAL);
+    present();
+    mu_assert_int_eq(1, blits);
+    mu_assert_int_eq(FULL_FRAME_BYTES, bytes_transferred);
+}
+
+MU_TEST(unchanged_frame) {
+    present();
+    mu_assert_int_eq(0, blits);
+    mu_assert_int_eq(0, bytes_transferred);
+}
+
+MU_TEST(single_pixel) {
+    set_pixel(21, 35, 0);
+    present();
+    mu_assert_int_eq(1, blits);
+    mu_assert_int_eq(TILE_BYTES, bytes_transferred);
+    mu_assert_int_eq(16, last_rect.x);
+    mu_assert_int_eq(32, last_rect.y);
+
+    // Only output once
+    present();
+    mu_assert_int_eq(0, blits);
+}
+
+MU_TEST(horizontal_merge) {
+    set_pixel(7, 0, 0);
+    set_pixel(8, 0, 0);
+    set_pixel(16, 7, 0);
+    present();
+    mu_assert_int_eq(1, blits);
+    mu_assert_int_eq(3 * TILE_BYTES, bytes_transferred);
+    mu_assert_int_eq(24, last_rect.width);
+    mu_assert_int_eq(8, last_rect.height);
+}
+
+MU_TEST(vertical_merge) {
+    set_pixel(40, 7, 0);
+    set_pixel(40, 8, 0);
+    set_pixel(47, 16, 0);
+    present();
+    mu_assert_int_eq(1, blits);
+    mu_assert_int_eq(3 * TILE_BYTES, bytes_transferred);
+    mu_assert_int_eq(8, last_rect.width);
+    mu_assert_int_eq(24, last_rect.height);
+}
+
+MU_TEST(separate_regions) {
+    set_pixel(0, 0, 0);
+    set_pixel(GB_PIXELS_X - 1, GB_PIXELS_Y - 1, 0);
+    present();
+    mu_assert_int_eq(2, blits);
+    mu_assert_int_eq(2 * TILE_BYTES, bytes_transferred);
+}
+
+MU_TEST(forced_refresh) {
+    force_full_refresh(&tracker);
+    present();
+    mu_assert_int_eq(1, blits);
+    mu_assert_int_eq(FULL_FRAME_BYTES, bytes_transferred);
+}
+
+MU_TEST(periodic_refresh) {
+    for (int i = 1; i < REFRESH_INTERVAL; i++) {
+        present();
+        mu_assert_int_eq(0, bytes_transferred);
+    }
+    present();
+    mu_assert_int_eq(FULL_FRAME_BYTES, bytes_transferred);
+}
+
+
+MU_TEST_SUITE(dirty_rects) {
+
+	MU_SUITE_CONFIGURE(&setup, &teardown)
+    ;
+    MU_RUN_TEST(first_frame_full);
+    MU_RUN_TEST(unchanged_frame);
+    MU_RUN_TEST(single_pixel);
+    MU_RUN_TEST(horizontal_merge);
+    MU_RUN_TEST(vertical_merge);
+    MU_RUN_TEST(separate_regions);
+    MU_RUN_TEST(forced_refresh);
+    MU_RUN_TEST(periodic_refresh);
+}
+
+
+int main() {
+    MU_RUN_SUITE(dirty_rects);
+    MU_REPORT();
+    return 0;
+}
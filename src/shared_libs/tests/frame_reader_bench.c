@@ -0,0 +1,158 @@
+#define FRAME_EXPORT
+#include "../../core/frame_export.c"
+#include "../frame_reader.c"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Measures how many frames per second can be read from many exporting
+ * instances at once. Each instance has a writer thread exporting frames
+ * at the Gameboy's framerate and several reader threads copying the
+ * latest frame as often as they can, every frame read is checked to be
+ * entirely from a single frame. Pass 0 to export frames as fast as
+ * possible instead */
+
+#define INSTANCES 8
+#define READERS_PER_INSTANCE 2
+#define SECONDS 2
+#define FRAME_PIXELS (FRAME_EXPORT_WIDTH * FRAME_EXPORT_HEIGHT)
+#define FRAME_NS 16742706 // 1 / 59.73 seconds
+
+typedef struct {
+    Frame_Export writer;
+    char name[64];
+    unsigned long frames_written;
+} Instance;
+
+typedef struct {
+    Instance *instance;
+    unsigned long frames_read;
+    unsigned long new_frames; // Frames read which hadn't been read before
+    unsigned long torn_frames;
+} Reader_Stats;
+
+static Instance instances[INSTANCES];
+static Reader_Stats readers[INSTANCES * READERS_PER_INSTANCE];
+static volatile int stop = 0;
+static int paced = 1;
+
+void log_message(LogLevel ll, const char *fmt, ...) {
+    (void)ll;
+    (void)fmt;
+}
+
+// Every pixel of a frame is its frame number
+static void *write_frames(void *arg) {
+    Instance *instance = arg;
+    uint32_t value = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!stop) {
+        if (paced) {
+            next.tv_nsec += FRAME_NS;
+            if (next.tv_nsec >= 1000000000) {
+                next.tv_nsec -= 1000000000;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+
+        uint32_t *pixels = begin_export_frame(&instance->writer);
+        value++;
+        for (int i = 0; i < FRAME_PIXELS; i++) {
+            pixels[i] = value;
+        }
+        finish_export_frame(&instance->writer);
+        instance->frames_written++;
+    }
+    return NULL;
+}
+
+static void *read_frames(void *arg) {
+    Reader_Stats *stats = arg;
+    uint32_t *frame = malloc(FRAME_PIXELS * sizeof(uint32_t));
+    Frame_Reader reader;
+
+    if (frame == NULL || !open_frame_reader(&reader, stats->instance->name)) {
+        free(frame);
+        return NULL;
+    }
+
+    uint64_t last = 0;
+    while (!stop) {
+        uint64_t n = read_frame(&reader, frame);
+        if (n == 0) {
+            continue;
+        }
+        stats->frames_read++;
+        if (n != last) {
+            stats->new_frames++;
+            last = n;
+        }
+        for (int i = 1; i < FRAME_PIXELS; i++) {
+            if (frame[i] != frame[0]) {
+                stats->torn_frames++;
+                break;
+            }
+        }
+    }
+
+    close_frame_reader(&reader);
+    free(frame);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        paced = atoi(argv[1]);
+    }
+
+    pthread_t threads[INSTANCES * (1 + READERS_PER_INSTANCE)];
+    int thread_count = 0;
+
+    for (int i = 0; i < INSTANCES; i++) {
+        snprintf(instances[i].name, sizeof(instances[i].name), "/frame_reader_bench_%d_%d", (int)getpid(), i);
+        if (!create_frame_export(&instances[i].writer, instances[i].name)) {
+            printf("Unable to create %s\n", instances[i].name);
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < INSTANCES; i++) {
+        pthread_create(&threads[thread_count++], NULL, write_frames, &instances[i]);
+        for (int r = 0; r < READERS_PER_INSTANCE; r++) {
+            Reader_Stats *stats = &readers[(i * READERS_PER_INSTANCE) + r];
+            stats->instance = &instances[i];
+            pthread_create(&threads[thread_count++], NULL, read_frames, stats);
+        }
+    }
+
+    sleep(SECONDS);
+    stop = 1;
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    unsigned long written = 0, read = 0, new_frames = 0, torn = 0;
+    for (int i = 0; i < INSTANCES; i++) {
+        written += instances[i].frames_written;
+        destroy_frame_export(&instances[i].writer);
+    }
+    for (int i = 0; i < INSTANCES * READERS_PER_INSTANCE; i++) {
+        read += readers[i].frames_read;
+        new_frames += readers[i].new_frames;
+        torn += readers[i].torn_frames;
+    }
+
+    int reader_count = INSTANCES * READERS_PER_INSTANCE;
+    printf("%d instances (%s), %d readers each\n", INSTANCES, paced ? "paced" : "unpaced", READERS_PER_INSTANCE);
+    printf("written %10.0f frames/s\n", (double)written / SECONDS);
+    printf("read    %10.0f frames/s (%.0f per reader)\n", (double)read / SECONDS,
+        (double)read / SECONDS / reader_count);
+    printf("new     %10.0f frames/s (%.0f per reader)\n", (double)new_frames / SECONDS,
+        (double)new_frames / SECONDS / reader_count);
+    printf("torn    %10lu\n", torn);
+    return torn != 0;
+}
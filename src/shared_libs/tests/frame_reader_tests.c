@@ -0,0 +1,132 @@
+#define FRAME_EXPORT
+#include "../../core/frame_export.c"
+#include "../frame_reader.c"
+#include "minunit/minunit.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAME_PIXELS (FRAME_EXPORT_WIDTH * FRAME_EXPORT_HEIGHT)
+
+static Frame_Export writer;
+static Frame_Reader reader;
+static char name[64];
+static uint32_t frame[FRAME_PIXELS];
+
+void log_message(LogLevel ll, const char *fmt, ...) {
+    (void)ll;
+    (void)fmt;
+}
+
+
+static void write_frame(uint32_t color) {
+    uint32_t *pixels = begin_export_frame(&writer);
+    for (int i = 0; i < FRAME_PIXELS; i++) {
+        pixels[i] = color;
+    }
+    finish_export_frame(&writer);
+}
+
+static int frame_is(uint32_t color) {
+    for (int i = 0; i < FRAME_PIXELS; i++) {
+        if (frame[i] != color) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+void setup() {
+    snprintf(name, sizeof(name), "/frame_reader_tests_%d", (int)getpid());
+    create_frame_export(&writer, name);
+    open_frame_reader(&reader, name);
+}
+
+void teardown() {
+    close_frame_reader(&reader);
+    destroy_frame_export(&writer);
+}
+
+
+MU_TEST(open_missing) {
+    Frame_Reader missing;
+    mu_check(!open_frame_reader(&missing, "/frame_reader_tests_missing"));
+}
+
+MU_TEST(no_frames_yet) {
+    Frame_View view;
+    mu_check(reader.segment != NULL);
+    mu_assert_int_eq(0, exported_frames(&reader));
+    mu_check(!begin_frame_view(&reader, &view));
+    mu_assert_int_eq(0, read_frame(&reader, frame));
+}
+
+MU_TEST(read_latest) {
+    write_frame(0x112233);
+    mu_assert_int_eq(1, read_frame(&reader, frame));
+    mu_check(frame_is(0x112233));
+
+    write_frame(0x445566);
+    write_frame(0x778899);
+    mu_assert_int_eq(3, exported_frames(&reader));
+    mu_assert_int_eq(3, read_frame(&reader, frame));
+    mu_check(frame_is(0x778899));
+}
+
+// The latest frame is untouched while the next is written
+MU_TEST(view_during_next_frame) {
+    Frame_View view;
+    write_frame(0x112233);
+    mu_check(begin_frame_view(&reader, &view));
+
+    uint32_t *pixels = begin_export_frame(&writer);
+    pixels[0] = 0x445566;
+    mu_check(view.pixels[0] == 0x112233);
+    mu_check(end_frame_view(&reader, &view));
+
+    finish_export_frame(&writer);
+    mu_check(end_frame_view(&reader, &view));
+}
+
+MU_TEST(view_overwritten) {
+    Frame_View view;
+    write_frame(0x112233);
+    mu_check(begin_frame_view(&reader, &view));
+    mu_assert_int_eq(1, view.frame);
+
+    // The frame after next reuses the slot being read
+    write_frame(0x445566);
+    begin_export_frame(&writer);
+    mu_check(!end_frame_view(&reader, &view));
+}
+
+// A frame cut short is continued rather than published
+MU_TEST(unfinished_frame) {
+    write_frame(0x112233);
+    uint32_t *first = begin_export_frame(&writer);
+    uint32_t *second = begin_export_frame(&writer);
+    mu_check(first == second);
+
+    mu_assert_int_eq(1, read_frame(&reader, frame));
+    mu_check(frame_is(0x112233));
+}
+
+
+MU_TEST_SUITE(frame_reader) {
+
+	MU_SUITE_CONFIGURE(&setup, &teardown)
+    ;
+    MU_RUN_TEST(open_missing);
+    MU_RUN_TEST(no_frames_yet);
+    MU_RUN_TEST(read_latest);
+    MU_RUN_TEST(view_during_next_frame);
+    MU_RUN_TEST(view_overwritten);
+    MU_RUN_TEST(unfinished_frame);
+}
+
+
+int main() {
+    MU_RUN_SUITE(frame_reader);
+    MU_REPORT();
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "../frame_stream.c"
+#include "minunit/minunit.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static Stream_Encoder encoder;
+static Stream_Decoder decoder;
+static uint32_t frame[STREAM_PIXELS];
+static uint8_t buffer[STREAM_MAX_FRAME_SIZE];
+
+static uint32_t const dmg_colors[4] = {0xFFFFFF, 0xAAAAAA, 0x555555, 0x000000};
+
+
+// Encode frame, check it decodes to the same frame and return its size
+static unsigned long round_trip() {
+    unsigned long size = encode_stream_frame(&encoder, frame, buffer);
+    if (size > STREAM_MAX_FRAME_SIZE || decode_stream_frame(&decoder, buffer, size) != size) {
+        return 0;
+    }
+    return memcmp(decoder.pixels, frame, sizeof(frame)) == 0 ? size : 0;
+}
+
+static void fill_dmg() {
+    for (int i = 0; i < STREAM_PIXELS; i++) {
+        frame[i] = dmg_colors[(i / 3) % 4];
+    }
+}
+
+
+void setup() {
+    init_stream_encoder(&encoder);
+    init_stream_decoder(&decoder);
+    fill_dmg();
+}
+
+void teardown() {
+}
+
+
+// A 4 colour frame is sent at 2 bits per pixel
+MU_TEST(dmg_key_frame) {
+    mu_check(round_trip() != 0);
+    mu_check(buffer[4] & STREAM_PALETTE_RESET);
+    mu_assert_int_eq(2, buffer[5]);
+    mu_assert_int_eq(4, buffer[6] | (buffer[7] << 8));
+}
+
+// Only the tile containing a change is sent
+MU_TEST(changed_tiles) {
+    round_trip();
+    unsigned long unchanged = round_trip();
+    mu_check(unchanged != 0);
+    mu_check(unchanged < 32);
+
+    frame[(100 * STREAM_WIDTH) + 50] = dmg_colors[3];
+    frame[(101 * STREAM_WIDTH) + 51] = dmg_colors[0];
+    unsigned long changed = round_trip();
+    mu_check(changed != 0);
+    // One 2bpp tile is 16 bytes
+    mu_check(changed <= unchanged + 24);
+    mu_assert_int_eq(0, buffer[4]);
+    mu_assert_int_eq(0, buffer[6] | (buffer[7] << 8));
+}
+
+// New colours are added to the palette without resending every tile
+MU_TEST(palette_grows) {
+    round_trip();
+    for (int i = 0; i < 16; i++) {
+        frame[i] = 0x010000 * (i + 1);
+    }
+    mu_check(round_trip() != 0);
+    mu_assert_int_eq(0, buffer[4]);
+    mu_assert_int_eq(8, buffer[5]);
+    mu_assert_int_eq(16, buffer[6] | (buffer[7] << 8));
+    mu_assert_int_eq(20, encoder.palette_size);
+}
+
+// Once 256 colours have been seen the palette starts again
+MU_TEST(palette_overflow) {
+    for (int f = 0; f < 100; f++) {
+        for (int i = 0; i < STREAM_PIXELS; i++) {
+            frame[i] = (f * 8) + (i % 8);
+        }
+        mu_check(round_trip() != 0);
+        if (f == 32) {
+            mu_check(buffer[4] & STREAM_PALETTE_RESET);
+            mu_assert_int_eq(8, encoder.palette_size);
+        }
+    }
+}
+
+// A frame with more than 256 colours is sent as 32 bit colours
+MU_TEST(direct) {
+    for (int i = 0; i < STREAM_PIXELS; i++) {
+        frame[i] = i;
+    }
+    mu_check(round_trip() != 0);
+    mu_assert_int_eq(STREAM_PALETTE_RESET | STREAM_DIRECT, buffer[4]);
+    mu_assert_int_eq(32, buffer[5]);
+
+    fill_dmg();
+    mu_check(round_trip() != 0);
+    mu_assert_int_eq(STREAM_PALETTE_RESET, buffer[4]);
+    mu_assert_int_eq(2, buffer[5]);
+}
+
+// A viewer joining late can start from a key frame
+MU_TEST(key_frame) {
+    round_trip();
+    frame[0] = dmg_colors[2];
+    round_trip();
+
+    force_key_frame(&encoder);
+    unsigned long size = encode_stream_frame(&encoder, frame, buffer);
+    Stream_Decoder late;
+    init_stream_decoder(&late);
+    mu_assert_int_eq(size, decode_stream_frame(&late, buffer, size));
+    mu_check(memcmp(late.pixels, frame, sizeof(frame)) == 0);
+}
+
+MU_TEST(invalid) {
+    unsigned long size = encode_stream_frame(&encoder, frame, buffer);
+    for (unsigned long cut = 0; cut < size; cut += 7) {
+        init_stream_decoder(&decoder);
+        mu_assert_int_eq(0, decode_stream_frame(&decoder, buffer, cut));
+    }
+    buffer[5] = 3;
+    mu_assert_int_eq(0, decode_stream_frame(&decoder, buffer, size));
+}
+
+MU_TEST(stats) {
+    unsigned long first = round_trip();
+    unsigned long second = round_trip();
+
+    unsigned long frames;
+    unsigned long long total;
+    unsigned long last;
+    get_stream_stats(&encoder, &frames, &total, &last);
+    mu_assert_int_eq(2, frames);
+    mu_assert_int_eq(first + second, total);
+    mu_assert_int_eq(second, last);
+}
+
+
+MU_TEST_SUITE(frame_stream) {
+
+	MU_SUITE_CONFIGURE(&setup, &teardown)
+    ;
+    MU_RUN_TEST(dmg_key_frame);
+    MU_RUN_TEST(changed_tiles);
+    MU_RUN_TEST(palette_grows);
+    MU_RUN_TEST(palette_overflow);
+    MU_RUN_TEST(direct);
+    MU_RUN_TEST(key_frame);
+    MU_RUN_TEST(invalid);
+    MU_RUN_TEST(stats);
+}
+
+
+int main() {
+    MU_RUN_SUITE(frame_stream);
+    MU_REPORT();
+    return 0;
+}
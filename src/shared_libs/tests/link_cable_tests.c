@@ -0,0 +1,136 @@
+#include "../link_cable.c"
+#include "minunit/minunit.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#define THREAD_TRANSFERS 100000
+
+static Link_Cable cable;
+static Link_End a, b;
+
+
+void setup() {
+    init_link_cable(&cable);
+    attach_link_end(&a, &cable, 0);
+    attach_link_end(&b, &cable, 1);
+}
+
+void teardown() {
+    detach_link_end(&a);
+    detach_link_end(&b);
+}
+
+
+MU_TEST(attach) {
+    Link_End c;
+    mu_assert_int_eq(0, attach_link_end(&c, &cable, 1));
+    detach_link_end(&b);
+    mu_assert_int_eq(1, attach_link_end(&c, &cable, 1));
+    detach_link_end(&c);
+}
+
+// Both bytes are exchanged once the externally clocked side has offered
+MU_TEST(exchange) {
+    uint8_t recv_a = 0, recv_b = 0;
+    mu_assert_int_eq(LINK_WAITING, link_transfer_int(&a, 0x12, &recv_a));
+    mu_assert_int_eq(0, link_data_waiting(&a));
+    mu_assert_int_eq(LINK_WAITING, link_transfer_ext(&b, 0x34, &recv_b));
+    mu_assert_int_eq(1, link_data_waiting(&a));
+    // Polling again doesn't offer the byte twice
+    mu_assert_int_eq(LINK_WAITING, link_transfer_ext(&b, 0x34, &recv_b));
+
+    mu_assert_int_eq(LINK_DONE, link_transfer_int(&a, 0x12, &recv_a));
+    mu_assert_int_eq(0x34, recv_a);
+    mu_assert_int_eq(0, link_data_waiting(&a));
+    mu_assert_int_eq(1, link_data_waiting(&b));
+    mu_assert_int_eq(LINK_DONE, link_transfer_ext(&b, 0x34, &recv_b));
+    mu_assert_int_eq(0x12, recv_b);
+
+    mu_assert_int_eq(LINK_WAITING, link_transfer_int(&a, 0x56, &recv_a));
+}
+
+MU_TEST(no_peer) {
+    uint8_t recv;
+    // Both sides using their internal clock
+    mu_assert_int_eq(LINK_WAITING, link_transfer_int(&a, 0x12, &recv));
+    mu_assert_int_eq(LINK_NO_PEER, link_transfer_int(&b, 0x34, &recv));
+
+    detach_link_end(&b);
+    mu_assert_int_eq(LINK_NO_PEER, link_transfer_int(&a, 0x12, &recv));
+}
+
+// The other side ran a whole window without offering a byte
+MU_TEST(window) {
+    uint8_t recv;
+    link_add_cycles(&b, LINK_WINDOW_CYCLES + 1);
+    mu_assert_int_eq(1, link_too_far_ahead(&b));
+    mu_assert_int_eq(0, link_too_far_ahead(&a));
+
+    // Waiting for an offer lets the other side run on for a whole window
+    mu_assert_int_eq(LINK_WAITING, link_transfer_int(&a, 0x12, &recv));
+    mu_assert_int_eq(0, link_too_far_ahead(&b));
+    link_add_cycles(&b, LINK_WINDOW_CYCLES - 1);
+    mu_assert_int_eq(LINK_WAITING, link_transfer_int(&a, 0x12, &recv));
+    link_add_cycles(&b, 1);
+    mu_assert_int_eq(LINK_NO_PEER, link_transfer_int(&a, 0x12, &recv));
+
+    mu_assert_int_eq(1, link_too_far_ahead(&b));
+    link_add_cycles(&a, 2 * LINK_WINDOW_CYCLES);
+    mu_assert_int_eq(0, link_too_far_ahead(&b));
+}
+
+
+static void *ext_side(void *arg) {
+    (void)arg;
+    uint8_t recv;
+    for (int i = 0; i < THREAD_TRANSFERS; i++) {
+        while (link_transfer_ext(&b, i * 3, &recv) != LINK_DONE) {
+            sched_yield();
+        }
+        if (recv != (uint8_t)(i * 7)) {
+            return (void *)1;
+        }
+    }
+    return NULL;
+}
+
+// Every byte arrives in order with the other side on another thread
+MU_TEST(threads) {
+    pthread_t thread;
+    pthread_create(&thread, NULL, ext_side, NULL);
+
+    int errors = 0;
+    uint8_t recv;
+    for (int i = 0; i < THREAD_TRANSFERS; i++) {
+        Link_Status status;
+        while ((status = link_transfer_int(&a, i * 7, &recv)) == LINK_WAITING) {
+            sched_yield();
+        }
+        errors += status != LINK_DONE || recv != (uint8_t)(i * 3);
+    }
+
+    void *result;
+    pthread_join(thread, &result);
+    mu_assert_int_eq(0, errors);
+    mu_check(result == NULL);
+}
+
+
+MU_TEST_SUITE(link_cable) {
+
+	MU_SUITE_CONFIGURE(&setup, &teardown)
+    ;
+    MU_RUN_TEST(attach);
+    MU_RUN_TEST(exchange);
+    MU_RUN_TEST(no_peer);
+    MU_RUN_TEST(window);
+    MU_RUN_TEST(threads);
+}
+
+
+int main() {
+    MU_RUN_SUITE(link_cable);
+    MU_REPORT();
+    return 0;
+}
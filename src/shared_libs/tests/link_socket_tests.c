@@ -0,0 +1,124 @@
+#include "../link_socket.c"
+#include "minunit/minunit.h"
+#include <pthread.h>
+#include <stdio.h>
+
+#define TRANSFERS 1000
+
+static Link_Socket ls;
+static Link_Socket peer;
+static int peer_fd;
+static pthread_t peer_thread;
+static volatile int peer_running;
+static uint8_t (*peer_reply)(uint8_t, void *);
+
+// Stands in for the emulator using the external clock
+static void *stand_in(void *arg) {
+    (void)arg;
+    while (peer_running) {
+        struct pollfd p = {peer.fd, POLLIN, 0};
+        poll(&p, 1, 10);
+        link_socket_stand_in(&peer, peer_reply, NULL);
+    }
+    return NULL;
+}
+
+static void start_stand_in(uint8_t (*reply)(uint8_t, void *)) {
+    link_socket_init(&peer, peer_fd);
+    peer_reply = reply;
+    peer_running = 1;
+    pthread_create(&peer_thread, NULL, stand_in, NULL);
+}
+
+static uint8_t reply_changing(uint8_t clock, void *ctx) {
+    (void)ctx;
+    return clock ^ 0x5A;
+}
+
+
+static int clocked; // Transfers the side using the internal clock finished
+static int wrong; // Replies which weren't to the byte clocked
+
+static void run_program(int transfers) {
+    while (clocked < transfers) {
+        uint8_t recv;
+        if (link_socket_int(&ls, (uint8_t)clocked, &recv) != LINK_DONE) {
+            return;
+        }
+        wrong += recv != ((uint8_t)clocked ^ 0x5A);
+        clocked++;
+    }
+}
+
+
+void setup() {
+    int listen_fd = link_socket_listen(0);
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(listen_fd, (struct sockaddr *)&addr, &len);
+    link_socket_connect(&ls, ntohs(addr.sin_port));
+    peer_fd = accept(listen_fd, NULL, NULL);
+    close(listen_fd);
+    clocked = 0;
+    wrong = 0;
+    peer_running = 0;
+}
+
+void teardown() {
+    if (peer_running) {
+        peer_running = 0;
+        pthread_join(peer_thread, NULL);
+    }
+    link_socket_close(&ls);
+    close(peer_fd);
+}
+
+
+MU_TEST(exchange) {
+    start_stand_in(reply_changing);
+    run_program(TRANSFERS);
+    mu_assert_int_eq(TRANSFERS, clocked);
+    mu_assert_int_eq(TRANSFERS, ls.transfers);
+    mu_assert_int_eq(0, wrong);
+}
+
+MU_TEST(external_clock) {
+    uint8_t recv;
+    uint8_t msg[2] = {LINK_MSG_CLOCK, 0x12};
+    mu_assert_int_eq(LINK_WAITING, link_socket_ext(&ls, 0x34, &recv));
+
+    write(peer_fd, msg, 2);
+    struct pollfd p = {ls.fd, POLLIN, 0};
+    poll(&p, 1, 1000);
+    mu_assert_int_eq(LINK_DONE, link_socket_ext(&ls, 0x34, &recv));
+    mu_assert_int_eq(0x12, recv);
+    mu_assert_int_eq(2, read(peer_fd, msg, 2));
+    mu_assert_int_eq(LINK_MSG_REPLY, msg[0]);
+    mu_assert_int_eq(0x34, msg[1]);
+    mu_assert_int_eq(LINK_WAITING, link_socket_ext(&ls, 0x34, &recv));
+}
+
+MU_TEST(no_peer) {
+    uint8_t recv;
+    close(peer_fd);
+    peer_fd = -1;
+    mu_assert_int_eq(LINK_NO_PEER, link_socket_int(&ls, 0x12, &recv));
+    mu_assert_int_eq(0, link_socket_poll(&ls));
+}
+
+
+MU_TEST_SUITE(link_socket) {
+
+	MU_SUITE_CONFIGURE(&setup, &teardown)
+    ;
+    MU_RUN_TEST(exchange);
+    MU_RUN_TEST(external_clock);
+    MU_RUN_TEST(no_peer);
+}
+
+
+int main() {
+    MU_RUN_SUITE(link_socket);
+    MU_REPORT();
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "../scaler.c"
+#include "minunit/minunit.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SRC_WIDTH 13 // Not a multiple of the SIMD widths, so the remainder is tested
+#define SRC_HEIGHT 5
+#define PADDING 3 // Extra pixels per destination row which shouldn't be written to
+#define PAD_VALUE 0xDEADBEEF
+
+static uint32_t src[SRC_WIDTH * SRC_HEIGHT];
+static uint32_t dest[SRC_WIDTH * SRC_HEIGHT * (MAX_SCALE * MAX_SCALE + PADDING * MAX_SCALE)];
+
+
+void setup() {
+    for (int i = 0; i < SRC_WIDTH * SRC_HEIGHT; i++) {
+        src[i] = 0xFF000000 | (i * 0x010305);
+    }
+}
+
+void teardown() {
+    //Nothing
+}
+
+
+/* Scale the source image with every factor and format using the given
+ * instruction set, checking every pixel against a straightforward scale */
+static int check_all_scales(Scaler_SIMD simd) {
+
+    scaler_set_simd(simd);
+
+    for (int format = SCALE_BGRX; format <= SCALE_RGBX; format++) {
+        for (int factor = 1; factor <= MAX_SCALE; factor++) {
+            int stride = (SRC_WIDTH * factor) + PADDING;
+            for (int i = 0; i < stride * SRC_HEIGHT * factor; i++) {
+                dest[i] = PAD_VALUE;
+            }
+
+            if (!scale_pixels(src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH, dest, stride, factor, format)) {
+                return 0;
+            }
+
+            for (int y = 0; y < SRC_HEIGHT * factor; y++) {
+                for (int x = 0; x < stride; x++) {
+                    uint32_t expected = PAD_VALUE;
+                    if (x < SRC_WIDTH * factor) {
+                        uint32_t p = src[((y / factor) * SRC_WIDTH) + (x / factor)];
+                        expected = (format == SCALE_RGBX) ?
+                            ((p & 0xFF00FF00) | ((p & 0xFF) << 16) | ((p >> 16) & 0xFF)) : p;
+                    }
+                    if (dest[(y * stride) + x] != expected) {
+                        printf("Mismatch simd %d format %d factor %d at %d,%d\n", simd, format, factor, x, y);
+                        return 0;
+                    }
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+
+MU_TEST(portable_scaling) {
+    mu_check(check_all_scales(SCALER_PORTABLE));
+}
+
+// SIMD paths which aren't supported on this machine are skipped
+MU_TEST(sse2_scaling) {
+    if (scaler_best_simd() >= SCALER_SSE2) {
+        mu_check(check_all_scales(SCALER_SSE2));
+    }
+}
+
+MU_TEST(avx2_scaling) {
+    if (scaler_best_simd() >= SCALER_AVX2) {
+        mu_check(check_all_scales(SCALER_AVX2));
+    }
+}
+
+MU_TEST(invalid_factor) {
+    mu_check(!scale_pixels(src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH, dest, SRC_WIDTH, 0, SCALE_BGRX));
+    mu_check(!scale_pixels(src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH, dest, SRC_WIDTH, MAX_SCALE + 1, SCALE_BGRX));
+}
+
+MU_TEST(unsupported_simd) {
+    if (scaler_best_simd() < SCALER_AVX2) {
+        mu_check(!scaler_set_simd(SCALER_AVX2));
+    }
+    mu_check(scaler_set_simd(SCALER_PORTABLE));
+}
+
+
+MU_TEST_SUITE(scaler) {
+
+	MU_SUITE_CONFIGURE(&setup, &teardown)
+    ;
+    MU_RUN_TEST(portable_scaling);
+    MU_RUN_TEST(sse2_scaling);
+    MU_RUN_TEST(avx2_scaling);
+    MU_RUN_TEST(invalid_factor);
+    MU_RUN_TEST(unsupported_simd);
+}
+
+
+int main() {
+    MU_RUN_SUITE(scaler);
+    MU_REPORT();
+    return 0;
+}